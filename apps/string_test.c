@@ -0,0 +1,150 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+
+// Correctness test of the libc memory and string functions. It only relies on
+// the libc, so it runs the same on every board.
+
+#include <stdio.h>
+#include <string.h>
+
+// Largest copy size tested: covers the odd and even byte counts around the
+// word copies for every alignment.
+#define MAX_SIZE 40
+// Bytes around the tested area used to detect overflows.
+#define GUARD 4
+#define GUARD_BYTE 0xEE
+#define BUFFER_SIZE (MAX_SIZE + 2 * GUARD + 2)
+
+static unsigned char src[BUFFER_SIZE];
+static unsigned char dst[BUFFER_SIZE];
+
+static int errors;
+
+static void fail(const char *fn, size_t dst_off, size_t src_off, size_t n) {
+    printf("%s: dst+%u src+%u size %u: FAILED\n", fn, dst_off, src_off, n);
+    errors++;
+}
+
+// check verifies that <dst> holds <expected> on [<off>, <off> + <n>) and that
+// the guard bytes around it are untouched.
+static int check(size_t off, size_t n, const unsigned char *expected) {
+    for (size_t i = 0; i < BUFFER_SIZE; i++) {
+        if (i >= off && i < off + n) {
+            if (dst[i] != expected[i - off]) {
+                return 0;
+            }
+        } else if (dst[i] != GUARD_BYTE) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void test_memcpy(void) {
+    for (size_t d = GUARD; d < GUARD + 2; d++) {
+        for (size_t s = 0; s < 2; s++) {
+            for (size_t n = 0; n <= MAX_SIZE; n++) {
+                for (size_t i = 0; i < BUFFER_SIZE; i++) {
+                    dst[i] = GUARD_BYTE;
+                }
+                if (memcpy(dst + d, src + s, n) != dst + d ||
+                    !check(d, n, src + s)) {
+                    fail("memcpy", d, s, n);
+                }
+            }
+        }
+    }
+}
+
+static void test_memset(void) {
+    unsigned char expected[MAX_SIZE];
+
+    for (size_t d = GUARD; d < GUARD + 2; d++) {
+        for (size_t n = 0; n <= MAX_SIZE; n++) {
+            unsigned char value = (unsigned char)(0x80 + n);
+            for (size_t i = 0; i < BUFFER_SIZE; i++) {
+                dst[i] = GUARD_BYTE;
+            }
+            for (size_t i = 0; i < n; i++) {
+                expected[i] = value;
+            }
+            // Only the low byte of the value is used.
+            if (memset(dst + d, 0x1200 | value, n) != dst + d ||
+                !check(d, n, expected)) {
+                fail("memset", d, 0, n);
+            }
+        }
+    }
+}
+
+static void test_memcmp(void) {
+    for (size_t s = 0; s < 2; s++) {
+        for (size_t n = 1; n <= MAX_SIZE; n++) {
+            memcpy(dst, src + s, n);
+            if (memcmp(dst, src + s, n) != 0) {
+                fail("memcmp", 0, s, n);
+            }
+            // Differences are found on odd and even positions.
+            dst[n - 1]++;
+            if (memcmp(dst, src + s, n) <= 0 || memcmp(src + s, dst, n) >= 0) {
+                fail("memcmp", 0, s, n);
+            }
+        }
+    }
+}
+
+static void test_memchr(void) {
+    for (size_t n = 0; n <= MAX_SIZE; n++) {
+        for (size_t i = 0; i < n; i++) {
+            if (memchr(src, src[i], n) != src + i) {
+                fail("memchr", 0, i, n);
+            }
+        }
+        // The byte past the end is not searched.
+        if (memchr(src, src[n], n) != NULL) {
+            fail("memchr", 0, n, n);
+        }
+    }
+}
+
+static void test_strings(void) {
+    static const char *const words[] = {"", "a", "ab", "abc", "abd", "b"};
+    static const size_t lengths[] = {0, 1, 2, 3, 3, 1};
+    const size_t count = sizeof(words) / sizeof(words[0]);
+
+    // Words are sorted: the comparison follows their positions.
+    for (size_t i = 0; i < count; i++) {
+        if (strlen(words[i]) != lengths[i]) {
+            fail("strlen", 0, i, 0);
+        }
+        for (size_t j = 0; j < count; j++) {
+            int r = strcmp(words[i], words[j]);
+            if ((i < j && r >= 0) || (i == j && r != 0) || (i > j && r <= 0)) {
+                fail("strcmp", i, j, 0);
+            }
+        }
+    }
+    const char abc[8] = "abc";
+    if (strnlen(abc, 2) != 2 || strnlen(abc, 8) != 3 || strnlen(abc, 0) != 0) {
+        fail("strnlen", 0, 0, 0);
+    }
+    if (strncmp("abc", "abd", 2) != 0 || strncmp("abc", "abd", 3) >= 0 ||
+        strncmp("ab", "abc", 8) >= 0 || strncmp("b", "a", 0) != 0 ||
+        strncmp("abc", "abc", 8) != 0) {
+        fail("strncmp", 0, 0, 0);
+    }
+}
+
+int main(void) {
+    for (size_t i = 0; i < BUFFER_SIZE; i++) {
+        src[i] = (unsigned char)(i * 7 + 1);
+    }
+
+    test_memcpy();
+    test_memset();
+    test_memcmp();
+    test_memchr();
+    test_strings();
+
+    printf("string_test: %s\n", errors ? "FAILED" : "PASSED");
+    return errors ? 1 : 0;
+}
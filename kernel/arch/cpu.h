@@ -34,6 +34,13 @@ static inline void cli(void) { __asm__ __volatile__("cli"); }
 // sti sets the interrupts flag which enables the interruptions.
 static inline void sti(void) { __asm__ __volatile__("sti"); }
 
+// cpu_flags returns the current value of the CPU flags.
+static inline uint16_t cpu_flags(void) {
+    uint16_t flags;
+    __asm__ __volatile__("pushf\n\tpop %0" : "=r"(flags));
+    return flags;
+}
+
 // hlt pauses the processor until an interruption.
 static inline void hlt(void) { __asm__ __volatile__("hlt"); }
 
@@ -21,6 +21,7 @@ const struct pic pic0 = {
     .irq_enable = p8259a_irq_enable,
     .irq_disable = p8259a_irq_disable,
     .irq_ack = p8259a_irq_ack,
+    .irq_pending = p8259a_irq_pending,
 };
 
 DEVICE(pic, p8259a, pic0);
@@ -38,6 +39,7 @@ struct timer timer0 = {
     .ns_per_tick = p8254_ns_per_tick,
     .read = p8254_read,
     .set_alarm = p8254_set_alarm,
+    .set_oneshot = p8254_set_oneshot,
     .set_freq = p8254_set_freq,
 };
 
@@ -51,6 +53,7 @@ struct timer timer1 = {
     .ns_per_tick = p8254_ns_per_tick,
     .read = p8254_read,
     .set_alarm = p8254_set_alarm,
+    .set_oneshot = p8254_set_oneshot,
     .set_freq = p8254_set_freq,
 };
 
@@ -64,6 +67,7 @@ struct timer timer2 = {
     .ns_per_tick = p8254_ns_per_tick,
     .read = p8254_read,
     .set_alarm = p8254_set_alarm,
+    .set_oneshot = p8254_set_oneshot,
     .set_freq = p8254_set_freq,
 };
 
@@ -43,6 +43,12 @@ void p8254_set_alarm(struct timer *t, uint16_t counter) {
     p8254_configure_counter(t, MODE_RATE_GEN, counter);
 }
 
+void p8254_set_oneshot(struct timer *t, uint16_t counter) {
+    // The output rises once the counter reaches zero, the counter then wraps
+    // and keeps counting.
+    p8254_configure_counter(t, MODE_INT_TC, counter);
+}
+
 void p8254_set_freq(struct timer *t, uint32_t freq) {
     uint16_t divider = (uint16_t)(t->freq / freq);
     // Configure the counter to generate a square wave with a frequency of
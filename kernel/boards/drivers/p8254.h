@@ -10,6 +10,9 @@
 // p8254_set_alarm sets an alarm on <timer> firing every <count> clocks.
 void p8254_set_alarm(struct timer *t, uint16_t counter);
 
+// p8254_set_oneshot sets an alarm on <timer> firing once after <count> clocks.
+void p8254_set_oneshot(struct timer *t, uint16_t counter);
+
 // p8254_set_freq configures <timer> as a square wave generator with a frequency
 // of <freq>.
 void p8254_set_freq(struct timer *t, uint32_t freq);
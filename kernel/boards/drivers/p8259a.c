@@ -23,6 +23,8 @@
 #define ICW4_BUF_MASTER 0x0C  // Buffered mode/master
 #define ICW4_SFNM 0x10        // Special fully nested (not)
 
+#define OCW3_READ_IRR 0x0A  // Read the interrupt request register
+
 void p8259a_initialize(const struct pic *p) {
     // First configuration word (ICW1):
     // - Level triggered (not edge triggered)
@@ -63,3 +65,10 @@ void p8259a_irq_disable(const struct pic *p, int irq) {
 }
 
 void p8259a_irq_ack(const struct pic *p) { outb(PIC_CMD(p), 0x20); }
+
+int p8259a_irq_pending(const struct pic *p, int irq) {
+    // OCW3: read the interrupt request register, the default read mode after
+    // the initialization. Nothing else reads the command port.
+    outb(PIC_CMD(p), OCW3_READ_IRR);
+    return (inb(PIC_CMD(p)) >> irq) & 1;
+}
@@ -20,4 +20,7 @@ void p8259a_irq_disable(const struct pic *p, int irq);
 // p8259a_irq_ack acknowledges an external interrupt to the controler.
 void p8259a_irq_ack(const struct pic *p);
 
+// p8259a_irq_pending tells if the interrupt number <irq> is requested.
+int p8259a_irq_pending(const struct pic *p, int irq);
+
 #endif  // _IRQ_H_
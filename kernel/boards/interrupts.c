@@ -81,6 +81,18 @@ void irq_disable(int irq) {
     }
 }
 
+int irq_pending(int irq) {
+    if (irq < 0) {
+        return 0;
+    }
+    if (irq < p->irq_max) {
+        return p->irq_pending(p, irq);
+    } else if (p->slave && irq < p->slave->irq_max) {
+        return p->slave->irq_pending(p->slave, irq - p->slave->irq_base);
+    }
+    return 0;
+}
+
 void irq_ack(int irq) {
     if (irq < 0) {
         return;
@@ -26,6 +26,7 @@ struct pic {
     void (*irq_enable)(const struct pic *p, int irq);
     void (*irq_disable)(const struct pic *p, int irq);
     void (*irq_ack)(const struct pic *p);
+    int (*irq_pending)(const struct pic *p, int irq);
 };
 
 // interrupts_initialize installs the interruptions handlers, initializes the
@@ -48,4 +49,7 @@ void irq_disable(int irq);
 // irq_disable unmasks the IRQ |irq|.
 void irq_ack(int irq);
 
+// irq_pending tells if the IRQ |irq| was raised and is waiting to be served.
+int irq_pending(int irq);
+
 #endif  // _INTERRUPTS_H_
@@ -23,4 +23,8 @@ void timer_set_alarm(struct timer *t, uint16_t count) {
     t->set_alarm(t, count);
 }
 
+void timer_set_oneshot(struct timer *t, uint16_t count) {
+    t->set_oneshot(t, count);
+}
+
 void timer_set_freq(struct timer *t, uint32_t freq) { t->set_freq(t, freq); }
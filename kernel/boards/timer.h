@@ -19,6 +19,7 @@ struct timer {
     uint32_t (*ns_per_tick)(struct timer *t);
     uint16_t (*read)(struct timer *t);
     void (*set_alarm)(struct timer *t, uint16_t count);
+    void (*set_oneshot)(struct timer *t, uint16_t count);
     void (*set_freq)(struct timer *t, uint32_t freq);
 };
 
@@ -35,6 +36,10 @@ uint16_t timer_read(struct timer *t);
 // timer_set_alarm sets the timer to fire an interruption after |count| ticks.
 void timer_set_alarm(struct timer *t, uint16_t count);
 
+// timer_set_oneshot sets the timer to fire a single interruption after |count|
+// ticks. The timer keeps counting down from its maximum value afterwards.
+void timer_set_oneshot(struct timer *t, uint16_t count);
+
 // timer_set_freq configures the timer to fire an interruption at frequency
 // |freq|.
 void timer_set_freq(struct timer *t, uint32_t freq);
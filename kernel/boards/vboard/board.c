@@ -22,6 +22,7 @@ const struct pic pic1 = {
     .irq_enable = p8259a_irq_enable,
     .irq_disable = p8259a_irq_disable,
     .irq_ack = p8259a_irq_ack,
+    .irq_pending = p8259a_irq_pending,
 };
 
 const struct pic pic0 = {
@@ -35,6 +36,7 @@ const struct pic pic0 = {
     .irq_enable = p8259a_irq_enable,
     .irq_disable = p8259a_irq_disable,
     .irq_ack = p8259a_irq_ack,
+    .irq_pending = p8259a_irq_pending,
 };
 
 DEVICE(pic, p8259a, pic0);
@@ -56,6 +58,7 @@ struct timer timer0 = {
     .ns_per_tick = p8254_ns_per_tick,
     .read = p8254_read,
     .set_alarm = p8254_set_alarm,
+    .set_oneshot = p8254_set_oneshot,
     .set_freq = p8254_set_freq,
 };
 
@@ -69,6 +72,7 @@ struct timer timer1 = {
     .ns_per_tick = p8254_ns_per_tick,
     .read = p8254_read,
     .set_alarm = p8254_set_alarm,
+    .set_oneshot = p8254_set_oneshot,
     .set_freq = p8254_set_freq,
 };
 
@@ -82,6 +86,7 @@ struct timer timer2 = {
     .ns_per_tick = p8254_ns_per_tick,
     .read = p8254_read,
     .set_alarm = p8254_set_alarm,
+    .set_oneshot = p8254_set_oneshot,
     .set_freq = p8254_set_freq,
 };
 
@@ -2,6 +2,7 @@
 
 #include "clk.h"
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -12,28 +13,53 @@
 #include "devices.h"
 #include "error.h"
 #include "interrupts.h"
-#include "list.h"
+#include "ktimer.h"
 #include "scheduler.h"
+#include "softirq.h"
 #include "timer.h"
+#include "waitqueue.h"
 
 #define S_TO_NS(v) ((v)*1000000000)
 #define MS_TO_NS(v) ((v)*1000000)
 #define NS_TO_S(v) ((v) / 1000000000)
 
+// Duration of a clock tick.
+#define TICK_NS MS_TO_NS(CLOCK_INC_MS)
+
+// Longest one-shot alarm, in timer counts. It leaves a margin below the wrap of
+// the counter to tell a fired alarm from a pending one.
+#define ONESHOT_MAX_COUNTS 0xff00
+
 // Device behind the clock.
 static struct timer *t;
+// Timer counts in a clock tick.
+static uint16_t tick_counts;
+// Duration of a timer count in 1/16 ns.
+static uint32_t count_ns_q4;
+
+// Set while the periodic tick is stopped and a one-shot alarm is programmed.
+static bool oneshot;
+// Timer counts of the one-shot alarm.
+static uint16_t oneshot_counts;
+// Tick at which the one-shot alarm fires.
+static uint32_t oneshot_tick;
+// Timer counts elapsed in the current tick when the periodic tick is stopped.
+static uint32_t phase;
 
 // Kernel ticks.
 uint64_t ticks;
 // Kernel time since boot.
 uint64_t now_ns;
 
-// List of blocked processes.
-struct list_node blocked = LIST_INITIAL_VALUE(blocked);
-
 // Interruption request handler.
 void clk_int_handler(void);
 
+static void clk_run_timers(void *arg);
+static void clk_timer_added(uint32_t expires);
+// Deferred processing of the kernel timers.
+static struct tasklet timers_tasklet =
+    TASKLET_INITIAL_VALUE(clk_run_timers, NULL);
+
 void clk_initialize(void) {
     t = timer_get("timer0");
     if (!t) {
@@ -44,52 +70,239 @@ void clk_initialize(void) {
     // Prepare the system to regularly count.
     ticks = 0;
     now_ns = 0;
+    tick_counts = t->freq / 100;
+    count_ns_q4 = (TICK_NS << 4) / tick_counts;
+    oneshot = false;
+    ktimer_initialize(0);
+    ktimer_set_notify(clk_timer_added);
     interrupts_handle(interrupts_from_irq(t->irq), KERNEL_CS, clk_int_handler);
-    timer_set_alarm(t, t->freq / 100);
+    timer_set_alarm(t, tick_counts);
     irq_enable(t->irq);
 
+    // Measure the CPU time of the processes with the clock, and restart the
+    // tick as soon as the idle task is preempted.
+    scheduler_set_clock(clk_read_fast, t->freq);
+    scheduler_set_idle_exit(clk_idle_exit);
+
     printf("Clock: frequency: %luHz, period: %dms, using IRQ %d\n", t->freq,
            CLOCK_INC_MS, t->irq);
 }
 
-// Wake-up all the processes that have passed the deadline.
-static void clk_wakeup(void) {
-    if (list_is_empty(&blocked)) {
+// Runs the kernel timers that expired.
+static void clk_run_timers(void *arg) {
+    uint32_t now;
+
+    (void)arg;
+    // The clock interrupt may update the ticks while they're copied.
+    cli();
+    now = (uint32_t)ticks;
+    sti();
+    ktimer_run(now);
+}
+
+// Wakes up the process sleeping on the wait queue <arg> until its timer
+// expires.
+static void clk_wakeup(void *arg) { wait_queue_wake_one(arg); }
+
+// Tells if the sleep timer <arg> expired.
+static bool clk_expired(void *arg) { return !ktimer_pending(arg); }
+
+// clk_elapsed returns the timer counts elapsed since the clock was last
+// updated by the tick interrupt.
+static uint32_t clk_elapsed(void) {
+    uint16_t counts = timer_read(t);
+
+    if (oneshot) {
+        // A counter at zero or wrapped means the alarm fired, the counter keeps
+        // going down from its maximum value.
+        if (!counts || counts > oneshot_counts) {
+            return phase + oneshot_counts + (uint16_t)(0 - counts);
+        }
+        return phase + oneshot_counts - counts;
+    }
+
+    // The counter reloaded but the tick interrupt wasn't served yet: read it
+    // again, as the reload may have happened after the first read.
+    if (irq_pending(t->irq)) {
+        counts = timer_read(t);
+        return 2 * (uint32_t)tick_counts - counts;
+    }
+    return tick_counts - counts;
+}
+
+// clk_counts_to_ns converts a number of timer <counts> into nanoseconds.
+static uint32_t clk_counts_to_ns(uint32_t counts) {
+    // Split in ticks to avoid overflowing the fixed point product.
+    return (counts / tick_counts) * TICK_NS +
+           (((counts % tick_counts) * count_ns_q4) >> 4);
+}
+
+uint64_t clk_now_ns(void) {
+    if (!t) {
+        return now_ns;
+    }
+    return now_ns + clk_counts_to_ns(clk_elapsed());
+}
+
+uint32_t clk_read_fast(void) {
+    if (!t) {
+        return 0;
+    }
+    return (uint32_t)ticks * tick_counts + clk_elapsed();
+}
+
+uint32_t clk_fast_to_ns(uint32_t delta) { return clk_counts_to_ns(delta); }
+
+// clk_account adds the <counts> elapsed since the one-shot alarm was set to the
+// clock.
+static void clk_account(uint16_t counts) {
+    uint16_t n;
+
+    phase += counts;
+    n = phase / tick_counts;
+    phase %= tick_counts;
+    ticks += n;
+    now_ns += (uint64_t)n * TICK_NS;
+}
+
+// clk_resume_tick restarts the periodic tick. When the clock is in the middle
+// of a tick, a one-shot alarm first brings it back to the tick boundary.
+static void clk_resume_tick(void) {
+    if (phase) {
+        oneshot_counts = tick_counts - phase;
+        oneshot_tick = (uint32_t)ticks + 1;
+        timer_set_oneshot(t, oneshot_counts);
         return;
     }
+    oneshot = false;
+    timer_set_alarm(t, tick_counts);
+}
 
-    // For all the elements in the blocked list, unblock those who passed the
-    // deadline.
-    struct task *t, *tmp;
-    list_for_every_entry_safe(&blocked, t, tmp, struct task, node) {
-        uint64_t deadline = *(uint64_t *)t->wait_state;
-        if (deadline <= now_ns) {
-            list_delete(&t->node);
-            scheduler_wake_up(t);
+// clk_oneshot_arm stops the periodic tick, <counts> timer counts before the
+// next tick, and programs a one-shot alarm <remaining> ticks after it.
+static void clk_oneshot_arm(uint16_t counts, uint32_t remaining) {
+    // Deadlines past the timer range are reached with a chain of alarms.
+    if (remaining >= (ONESHOT_MAX_COUNTS - counts) / tick_counts) {
+        oneshot_counts = ONESHOT_MAX_COUNTS;
+    } else {
+        oneshot_counts = counts + (uint16_t)remaining * tick_counts;
+    }
+    phase = tick_counts - counts;
+    oneshot_tick = (uint32_t)ticks + (phase + oneshot_counts) / tick_counts;
+    oneshot = true;
+    timer_set_oneshot(t, oneshot_counts);
+}
+
+void clk_idle_enter(void) {
+    uint32_t expires, remaining;
+    uint16_t counts;
+
+    if (!t || oneshot) {
+        return;
+    }
+
+    // Counts left before the next tick, the periodic alarm reloads at 1.
+    counts = timer_read(t);
+    if (!counts || counts > tick_counts) {
+        return;
+    }
+    if (ktimer_next_expiry(&expires)) {
+        // Ticks between the next one and the first timer to fire.
+        remaining = expires - (uint32_t)ticks - 1;
+        if ((int32_t)remaining <= 0) {
+            // The next periodic tick is needed anyway.
+            return;
         }
+    } else {
+        // Nothing to wake up for, sleep as long as the timer allows: more
+        // ticks than a single alarm can cover.
+        remaining = ONESHOT_MAX_COUNTS;
+    }
+    // A tick latched since interrupts were disabled, or since the counter was
+    // read, would be taken for the one-shot alarm: let it be handled in
+    // periodic mode first.
+    if (irq_pending(t->irq)) {
+        return;
     }
+    clk_oneshot_arm(counts, remaining);
+}
+
+// clk_timer_added brings forward the one-shot alarm when a timer armed while
+// the tick is stopped fires before it.
+static void clk_timer_added(uint32_t expires) {
+    uint16_t flags = cpu_flags();
+    uint32_t remaining;
+    uint16_t counts;
+
+    // Timers are also added from tasklets: keep the clock interrupt away.
+    cli();
+    if (!oneshot || (int32_t)(expires - oneshot_tick) >= 0) {
+        goto out;
+    }
+    // A counter at zero or wrapped means the alarm fired, its interrupt will
+    // update the clock.
+    counts = timer_read(t);
+    if (!counts || counts > oneshot_counts) {
+        goto out;
+    }
+    clk_account(oneshot_counts - counts);
+    remaining = expires - (uint32_t)ticks - 1;
+    if ((int32_t)remaining <= 0) {
+        clk_resume_tick();
+    } else {
+        clk_oneshot_arm(tick_counts - phase, remaining);
+    }
+out:
+    if (flags & INTERRUPT_ENABLE_FLAG) {
+        sti();
+    }
+}
+
+void clk_idle_exit(void) {
+    uint16_t counts;
+
+    if (!oneshot) {
+        return;
+    }
+    // A counter at zero or wrapped means the alarm fired, its interrupt will
+    // update the clock.
+    counts = timer_read(t);
+    if (!counts || counts > oneshot_counts) {
+        return;
+    }
+    clk_account(oneshot_counts - counts);
+    clk_resume_tick();
 }
 
 void clk_handler(void) {
     // Increment the clock ticks and ack the interrupt as quickly as possible.
-    ticks++;
-    now_ns += MS_TO_NS(CLOCK_INC_MS);
+    if (oneshot) {
+        clk_account(oneshot_counts);
+        clk_resume_tick();
+    } else {
+        ticks++;
+        now_ns += TICK_NS;
+    }
     irq_ack(t->irq);
 
-    // Wake-up all the waiting processes that passed the deadline.
-    clk_wakeup();
+    // Run the timers that expired, waking up the processes that passed their
+    // deadline.
+    tasklet_schedule(&timers_tasklet);
+    softirq_run();
 
-    if ((ticks & 0x1) == 0) {
-        schedule();
-    }
+    // Charge the tick to the running process, and switch to the next one if it
+    // exhausted its time slice.
+    scheduler_tick();
+    scheduler_preempt();
 }
 
 int clk_gettime(clockid_t clockid, struct timespec *tp) {
     if (clockid != CLOCK_MONOTONIC || !tp) {
         return ERR_INVAL;
     }
-    tp->tv_sec = NS_TO_S(now_ns);
-    tp->tv_nsec = now_ns % S_TO_NS(1);
+    uint64_t now = clk_now_ns();
+    tp->tv_sec = NS_TO_S(now);
+    tp->tv_nsec = now % S_TO_NS(1);
     return 0;
 }
 
@@ -101,21 +314,27 @@ int clk_nanosleep(clockid_t clockid, int flags, const struct timespec *request,
     }
 
     uint64_t deadline;
+    uint64_t now = clk_now_ns();
+    struct ktimer timer;
+    struct wait_queue sleeper;
     if (flags & TIMER_ABSTIME) {
         // |request| contains an absolute time.
         deadline = S_TO_NS(request->tv_sec) + request->tv_nsec;
     } else {
         // request contains a delay relative to current clock.
-        deadline = now_ns + S_TO_NS(request->tv_sec) + request->tv_nsec;
+        deadline = now + S_TO_NS(request->tv_sec) + request->tv_nsec;
     }
 
     // If the deadline is in the past, nothing to do.
-    if (deadline <= now_ns) {
+    if (deadline <= now) {
         return 0;
     }
 
-    // Block until the deadline is reached.
-    scheduler_sleep_on(&blocked, &deadline);
+    // Block until the deadline is reached: the first tick at or after it.
+    wait_queue_init(&sleeper);
+    ktimer_init(&timer, clk_wakeup, &sleeper);
+    ktimer_add(&timer, (uint32_t)((deadline + TICK_NS - 1) / TICK_NS));
+    wait_queue_wait(&sleeper, clk_expired, &timer);
 
     // We'll be unblocked only after the deadline passed, no remain.
     if (remain) {
@@ -10,6 +10,28 @@
 // hooks the interruption.
 void clk_initialize(void);
 
+// clk_idle_enter stops the periodic tick until the first kernel timer to fire,
+// when the CPU has nothing to run. It must be called with interrupts disabled.
+void clk_idle_enter(void);
+
+// clk_idle_exit brings the clock up to date and restarts the periodic tick
+// stopped by clk_idle_enter(). The scheduler calls it whenever the idle task
+// is switched out. It must be called with interrupts disabled.
+void clk_idle_exit(void);
+
+// clk_now_ns returns the time since boot in nanoseconds, with the resolution
+// of the timer behind the clock. It must be called with interrupts disabled.
+uint64_t clk_now_ns(void);
+
+// clk_read_fast returns a free running counter incremented at the frequency of
+// the timer behind the clock, for profiling. It wraps around and must be called
+// with interrupts disabled. See clk_fast_to_ns().
+uint32_t clk_read_fast(void);
+
+// clk_fast_to_ns converts a difference of clk_read_fast() values into
+// nanoseconds. The result wraps around after about 4 seconds.
+uint32_t clk_fast_to_ns(uint32_t delta);
+
 int clk_gettime(clockid_t clockid, struct timespec *tp);
 
 int clk_nanosleep(clockid_t clockid, int flags, const struct timespec *request,
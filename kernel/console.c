@@ -3,12 +3,31 @@
 // Provide the basic fonctions to output char and strings on the current binded
 // stdout.
 
+#include "console.h"
+
+#include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 
 #include "board.h"
+#include "cpu.h"
+#include "error.h"
 #include "ringbuffer.h"
+#include "scheduler.h"
 #include "uart.h"
+#include "waitqueue.h"
+
+// Line rate of the console, it can be set at build time, e.g. with
+// --copt=-DCONSOLE_BAUD_RATE=115200. See console_ioctl() to change it later.
+#ifndef CONSOLE_BAUD_RATE
+#define CONSOLE_BAUD_RATE 38400
+#endif
+
+// The flow control modes of the console are passed as is to the UART driver.
+#if CONSOLE_FLOW_RTSCTS != UART_FLOW_RTSCTS || \
+    CONSOLE_FLOW_XONXOFF != UART_FLOW_XONXOFF
+#error "CONSOLE_FLOW_* and UART_FLOW_* flags must match"
+#endif
 
 // Size of the ring buffer.
 #define RINGBUF_SIZE 512
@@ -22,6 +41,19 @@ static char tx_buf[RINGBUF_SIZE];
 static ring_buffer_t tx_ring;
 // Tells if the UART is binded to the console.
 static int binded;
+// Tasks waiting for input.
+static struct wait_queue readers = WAIT_QUEUE_INITIAL_VALUE(readers);
+// Tasks waiting for room in the TX ring.
+static struct wait_queue writers = WAIT_QUEUE_INITIAL_VALUE(writers);
+// Number of chars dropped because the TX ring was full and the writer couldn't
+// wait.
+static unsigned long tx_dropped;
+// Tells if the input is delivered line by line.
+static int canonical;
+// Number of complete lines in the RX ring, in canonical mode.
+static size_t rx_lines;
+// Index in the RX ring of the first received char not scanned for lines yet.
+static size_t rx_scanned;
 
 static inline void console_start_xmit(void) {
     if (binded) {
@@ -29,46 +61,239 @@ static inline void console_start_xmit(void) {
     }
 }
 
+// console_rx_consumed lets the UART resume the reception once room was made in
+// the RX ring.
+static inline void console_rx_consumed(void) {
+    if (binded) {
+        uart_rx_consumed();
+    }
+}
+
 void console_initialize(void) {
     ring_buffer_init(&rx_ring, rx_buf, sizeof(rx_buf));
     ring_buffer_init(&tx_ring, tx_buf, sizeof(tx_buf));
     binded = 0;
+    tx_dropped = 0;
+    canonical = 0;
+    rx_lines = 0;
+    rx_scanned = 0;
 }
 
 void console_bind_uart(void) {
-    uart_initialize(&rx_ring, &tx_ring, 38400);
+    uart_initialize(&rx_ring, &tx_ring, CONSOLE_BAUD_RATE);
+#ifdef CONSOLE_RX_TRIGGER
+    uart_set_rx_trigger(CONSOLE_RX_TRIGGER);
+#endif
     binded = 1;
     if (!ring_buffer_is_empty(&tx_ring)) {
+        // Send the traces queued so far. The UART handler must not run while
+        // the FIFO is filled.
+        cli();
         console_start_xmit();
+        sti();
     }
 }
 
-int console_putchar(int c) {
-    if ((char)c == '\n') {
-        ring_buffer_queue(&tx_ring, '\r');
+// console_tx_room is the wait condition of the writers: the UART drained the
+// TX ring down to its low water mark.
+static bool console_tx_room(void *arg) {
+    (void)arg;
+    return ring_buffer_num_items(&tx_ring) <= UART_TX_LOW_WATER(&tx_ring);
+}
+
+// console_tx_wait waits for the UART to drain the full TX ring. Returns false
+// if the caller can't sleep, or if no UART drains the ring yet.
+static bool console_tx_wait(void) {
+    if (!binded || !scheduler_may_sleep()) {
+        return false;
     }
-    ring_buffer_queue(&tx_ring, (const char)c);
     console_start_xmit();
-    return 1;
+    wait_queue_wait(&writers, console_tx_room, NULL);
+    return true;
 }
 
-int console_puts(const char *s) {
-    int len = 0;
-    const char br[2] = {'\r', '\n'};
+int console_write(const char *buf, size_t len) {
+    const char crlf[2] = {'\r', '\n'};
+    const char *nl;
+    size_t span, queued;
+    size_t done = 0;
 
-    len = strlen(s);
-    ring_buffer_queue_arr(&tx_ring, s, len);
-    ring_buffer_queue_arr(&tx_ring, br, sizeof(br));
+    // The UART interrupt handler consumes the TX ring concurrently: never
+    // overwrite pending bytes, wait for room when the ring is full.
+    while (done < len) {
+        // Queue the chars up to the next line break at once.
+        nl = memchr(buf + done, '\n', len - done);
+        span = (nl ? (size_t)(nl - buf) : len) - done;
+        queued = ring_buffer_try_queue_arr(&tx_ring, buf + done, span);
+        done += queued;
+        // Line breaks are sent as CR LF.
+        if (queued == span && nl &&
+            RING_BUFFER_MASK(&tx_ring) - ring_buffer_num_items(&tx_ring) >=
+                sizeof(crlf)) {
+            ring_buffer_try_queue_arr(&tx_ring, crlf, sizeof(crlf));
+            done++;
+            continue;
+        }
+        if (done == len) {
+            break;
+        }
+        // The ring is full: the rest is dropped if the caller can't wait.
+        if (!console_tx_wait()) {
+            tx_dropped += len - done;
+            break;
+        }
+    }
     console_start_xmit();
-    return len + sizeof(br);
+    return done;
+}
+
+int console_write_polled(const char *buf, size_t len) {
+    size_t done;
+
+    // The UART isn't ready to send before it's binded.
+    if (!binded) {
+        return 0;
+    }
+    for (done = 0; done < len; done++) {
+        // Make room for a line break sent as CR LF.
+        if (RING_BUFFER_MASK(&tx_ring) - ring_buffer_num_items(&tx_ring) < 2) {
+            uart_flush();
+        }
+        if (buf[done] == '\n') {
+            ring_buffer_try_queue(&tx_ring, '\r');
+        }
+        ring_buffer_try_queue(&tx_ring, buf[done]);
+    }
+    uart_flush();
+    return done;
+}
+
+int console_putchar(int c) {
+    const char ch = (char)c;
+    return console_write(&ch, 1);
+}
+
+int console_puts(const char *s) {
+    int len = console_write(s, strlen(s));
+    return len + console_write("\n", 1);
 }
 
+unsigned long console_tx_dropped(void) { return tx_dropped; }
+
 int console_getchar(void) {
     char c;
 
-    if (ring_buffer_is_empty(&rx_ring)) {
-        return -1;
-    }
-    ring_buffer_dequeue(&rx_ring, &c);
+    console_read(&c, 1);
     return (int)c & 0xff;
-}
\ No newline at end of file
+}
+
+// console_rx_scan counts the lines received since the last scan. Carriage
+// returns sent by terminals are turned into line feeds.
+static void console_rx_scan(void) {
+    size_t head = rx_ring.head_index;
+
+    while (rx_scanned != head) {
+        if (rx_buf[rx_scanned] == '\r') {
+            rx_buf[rx_scanned] = '\n';
+        }
+        if (rx_buf[rx_scanned] == '\n') {
+            rx_lines++;
+        }
+        rx_scanned = (rx_scanned + 1) & RING_BUFFER_MASK(&rx_ring);
+    }
+}
+
+// console_rx_ready tells if a read can be served: there's a complete line in
+// canonical mode, or any char otherwise. A full ring is always served so that a
+// line longer than the ring can't block the reader.
+static int console_rx_ready(void) {
+    if (canonical) {
+        return rx_lines || ring_buffer_is_full(&rx_ring);
+    }
+    return !ring_buffer_is_empty(&rx_ring);
+}
+
+// console_can_read is the wait condition of the readers.
+static bool console_can_read(void *arg) {
+    (void)arg;
+    return console_rx_ready();
+}
+
+void console_set_canonical(int enable) {
+    canonical = enable;
+    rx_lines = 0;
+    rx_scanned = rx_ring.tail_index;
+    if (canonical) {
+        console_rx_scan();
+    }
+}
+
+int console_ioctl(int request, uint32_t arg) {
+    if (request == CONSOLE_SET_CANONICAL) {
+        console_set_canonical(arg != 0);
+        return 0;
+    }
+    if (!binded) {
+        return ERR_NO_DEV;
+    }
+    switch (request) {
+        case CONSOLE_SET_BAUD_RATE:
+            return uart_set_baud_rate(arg);
+        case CONSOLE_SET_RX_TRIGGER:
+            return uart_set_rx_trigger((int)arg);
+        case CONSOLE_SET_FLOW_CONTROL:
+            return uart_set_flow_control((int)arg);
+        default:
+            return ERR_INVAL;
+    }
+}
+
+int console_read(char *buf, size_t len) {
+    const char *data, *eol;
+    size_t n;
+    size_t done = 0;
+
+    if (!len) {
+        return 0;
+    }
+    // Interrupts are disabled: the RX interrupt can't be missed between the
+    // check and the sleep.
+    wait_queue_wait(&readers, console_can_read, NULL);
+    if (!canonical) {
+        done = ring_buffer_dequeue_arr(&rx_ring, buf, len);
+        console_rx_consumed();
+        return done;
+    }
+
+    // Deliver at most one line, in place from the ring.
+    while (done < len && (n = ring_buffer_peek_contiguous(&rx_ring, &data))) {
+        if (n > len - done) {
+            n = len - done;
+        }
+        eol = memchr(data, '\n', n);
+        if (eol) {
+            n = eol - data + 1;
+        }
+        memcpy(buf + done, data, n);
+        ring_buffer_commit_read(&rx_ring, n);
+        done += n;
+        if (eol) {
+            rx_lines--;
+            break;
+        }
+    }
+    console_rx_consumed();
+    return done;
+}
+
+void uart_tx_notify(void) { wait_queue_wake_all(&writers); }
+
+void uart_rx_notify(void) {
+    if (canonical) {
+        console_rx_scan();
+    }
+    if (!console_rx_ready()) {
+        return;
+    }
+    wait_queue_wake_all(&readers);
+}
@@ -3,20 +3,64 @@
 #ifndef _CONSOLE_H_
 #define _CONSOLE_H_
 
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+
 // console_initialize prepares the console to send and receive text.
 void console_initialize(void);
 
-// console_bind_uart
+// console_bind_uart starts sending and receiving through the board UART. It
+// must be called with interrupts enabled.
 void console_bind_uart(void);
 
-// console_putchar() writes <c> onto the binded console.
+// console_putchar() writes <c> onto the binded console. Returns 1 if the char
+// was queued, 0 if it was dropped, see console_write().
 int console_putchar(int c);
 
-// console_puts() writes <s> onto the binded console and add a carriage return.
+// console_write() writes the <len> chars of <buf> onto the binded console, line
+// breaks are sent as CR LF. When the output buffer is full, the calling task
+// sleeps until the UART makes room. Tasks that can't sleep, the deferred
+// interrupt work or writers before the UART is binded, drop the chars that
+// don't fit, see console_tx_dropped(). It must be called with interrupts
+// disabled, e.g. from a syscall. Returns the number of chars of <buf> queued.
+int console_write(const char *buf, size_t len);
+
+// console_write_polled() writes the <len> chars of <buf> onto the binded
+// console after the chars already queued, and polls the UART until they're all
+// sent. It neither sleeps nor needs the interrupts: it's meant for the last
+// messages before the system halts. It must be called with interrupts
+// disabled. Returns the number of chars of <buf> sent, 0 before the UART is
+// binded.
+int console_write_polled(const char *buf, size_t len);
+
+// console_puts() writes <s> onto the binded console and add a line break. See
+// console_write(). Returns the number of chars queued, line break included.
 int console_puts(const char *s);
 
-// console_getchar() returns the first available char for input on the binded
-// console.
+// console_tx_dropped() returns the number of chars dropped because the output
+// buffer was full.
+unsigned long console_tx_dropped(void);
+
+// console_read() reads up to <len> chars from the binded console into <buf>.
+// The calling task sleeps until at least one char is available, or a complete
+// line in canonical mode. It must be called with interrupts disabled, e.g. from
+// a syscall. Returns the number of chars read.
+int console_read(char *buf, size_t len);
+
+// console_getchar() returns the first char available for input on the binded
+// console, sleeping until there's one. See console_read().
 int console_getchar(void);
 
+// console_set_canonical() enables or disables the canonical input mode. In
+// canonical mode, the input is delivered line by line, reads return at most one
+// line and carriage returns are turned into line feeds.
+void console_set_canonical(int enable);
+
+// console_ioctl() configures the console according to <request>, one of the
+// CONSOLE_SET_* requests of sys/ioctl.h, with the value <arg>. Returns 0 on success, ERR_INVAL
+// if the request is unknown, ERR_NO_DEV if the request needs a UART and none is
+// binded, or the error returned by the UART driver.
+int console_ioctl(int request, uint32_t arg);
+
 #endif  // _CONSOLE_H_
@@ -0,0 +1,123 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+
+#include "ktimer.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "list.h"
+
+#define KTIMER_SLOT(tick) ((tick) & (KTIMER_WHEEL_SIZE - 1))
+
+// Tells if tick <a> is before or equal to tick <b>, across the counter wrap.
+#define KTIMER_BEFORE_EQ(a, b) ((int32_t)((a) - (b)) <= 0)
+
+static struct {
+    // Last tick processed.
+    uint32_t tick;
+    // Number of armed timers.
+    unsigned int count;
+    // Timers hashed by their expiration tick.
+    struct list_node slots[KTIMER_WHEEL_SIZE];
+    // Function told of the expiration of the timers armed.
+    void (*notify)(uint32_t expires);
+} wheel;
+
+void ktimer_initialize(uint32_t now) {
+    wheel.tick = now;
+    wheel.count = 0;
+    wheel.notify = NULL;
+    for (int i = 0; i < KTIMER_WHEEL_SIZE; i++) {
+        list_initialize(&wheel.slots[i]);
+    }
+}
+
+void ktimer_init(struct ktimer *t, void (*func)(void *arg), void *arg) {
+    list_clear_node(&t->node);
+    t->expires = 0;
+    t->func = func;
+    t->arg = arg;
+}
+
+void ktimer_add(struct ktimer *t, uint32_t expires) {
+    ktimer_cancel(t);
+    if (KTIMER_BEFORE_EQ(expires, wheel.tick)) {
+        expires = wheel.tick + 1;
+    }
+    t->expires = expires;
+    list_add_tail(&wheel.slots[KTIMER_SLOT(expires)], &t->node);
+    wheel.count++;
+    if (wheel.notify) {
+        wheel.notify(expires);
+    }
+}
+
+void ktimer_set_notify(void (*notify)(uint32_t expires)) {
+    wheel.notify = notify;
+}
+
+bool ktimer_cancel(struct ktimer *t) {
+    if (!list_in_list(&t->node)) {
+        return false;
+    }
+    list_delete(&t->node);
+    wheel.count--;
+    return true;
+}
+
+bool ktimer_pending(const struct ktimer *t) {
+    return t->node.prev != NULL || t->node.next != NULL;
+}
+
+uint32_t ktimer_now(void) { return wheel.tick; }
+
+bool ktimer_next_expiry(uint32_t *expires) {
+    struct ktimer *t;
+    bool found = false;
+
+    if (!wheel.count) {
+        return false;
+    }
+    for (int i = 0; i < KTIMER_WHEEL_SIZE; i++) {
+        list_for_every_entry(&wheel.slots[i], t, struct ktimer, node) {
+            if (!found || KTIMER_BEFORE_EQ(t->expires, *expires)) {
+                *expires = t->expires;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+// ktimer_expire runs the timers of the slot of the current tick that expire
+// now. Timers hashed to the same slot for a later turn of the wheel are left.
+static void ktimer_expire(void) {
+    struct list_node expired = LIST_INITIAL_VALUE(expired);
+    struct list_node *slot = &wheel.slots[KTIMER_SLOT(wheel.tick)];
+    struct ktimer *t, *tmp;
+
+    list_for_every_entry_safe(slot, t, tmp, struct ktimer, node) {
+        if (KTIMER_BEFORE_EQ(t->expires, wheel.tick)) {
+            list_delete(&t->node);
+            list_add_tail(&expired, &t->node);
+        }
+    }
+
+    // Functions may add or cancel any timer, including the expired ones.
+    while ((t = list_remove_head_type(&expired, struct ktimer, node))) {
+        wheel.count--;
+        t->func(t->arg);
+    }
+}
+
+void ktimer_run(uint32_t now) {
+    while (wheel.tick != now) {
+        // Nothing to expire, jump to the current tick.
+        if (!wheel.count) {
+            wheel.tick = now;
+            return;
+        }
+        wheel.tick++;
+        ktimer_expire();
+    }
+}
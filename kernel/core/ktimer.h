@@ -0,0 +1,70 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+//
+// Kernel timers: run a function once the clock reaches a given tick. Timers
+// are kept in a hashed wheel, each tick only looks at the timers hashed to its
+// slot, whatever the number of timers.
+//
+// Timers must be added and cancelled with interrupts disabled or from a
+// tasklet. Their functions run from the clock tasklet.
+
+#ifndef _KTIMER_H_
+#define _KTIMER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "list.h"
+
+// Number of slots of the wheel, a power of two.
+#define KTIMER_WHEEL_SIZE 32
+
+struct ktimer {
+    // Node in the wheel slot.
+    struct list_node node;
+    // Tick at which the timer fires.
+    uint32_t expires;
+    // Function to run and its argument.
+    void (*func)(void *arg);
+    void *arg;
+};
+
+#define KTIMER_INITIAL_VALUE(fn, data)                                  \
+    {                                                                   \
+        .node = LIST_INITIAL_CLEARED_VALUE, .expires = 0, .func = (fn), \
+        .arg = (data)                                                   \
+    }
+
+// ktimer_initialize resets the wheel with <now> as the current tick, and
+// removes the notification function.
+void ktimer_initialize(uint32_t now);
+
+// ktimer_init prepares <t> to run <func> with <arg>.
+void ktimer_init(struct ktimer *t, void (*func)(void *arg), void *arg);
+
+// ktimer_add arms <t> to fire at tick <expires>, or at the next tick if
+// <expires> already passed. A pending timer is moved to the new tick.
+void ktimer_add(struct ktimer *t, uint32_t expires);
+
+// ktimer_set_notify sets <notify>, called by ktimer_add() with the tick the
+// timer fires at, e.g. to bring forward a clock alarm. NULL disables it.
+void ktimer_set_notify(void (*notify)(uint32_t expires));
+
+// ktimer_cancel disarms <t>. Returns true if it was pending.
+bool ktimer_cancel(struct ktimer *t);
+
+// ktimer_pending tells if <t> is armed and didn't fire yet.
+bool ktimer_pending(const struct ktimer *t);
+
+// ktimer_now returns the last tick processed by the wheel.
+uint32_t ktimer_now(void);
+
+// ktimer_next_expiry stores in <expires> the tick of the first timer to fire.
+// Returns false if no timer is armed. Its cost grows with the number of timers,
+// it's meant to be used before stopping the clock tick.
+bool ktimer_next_expiry(uint32_t *expires);
+
+// ktimer_run advances the wheel up to tick <now> and runs the functions of the
+// timers that expired, in order.
+void ktimer_run(uint32_t now);
+
+#endif  // _KTIMER_H_
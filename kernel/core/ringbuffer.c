@@ -25,6 +25,16 @@
 
 #include "ringbuffer.h"
 
+#include <string.h>
+
+// Returns the smallest of two sizes.
+static inline size_t min_size(size_t a, size_t b) { return a < b ? a : b; }
+
+// Returns the size of the memory backing the ring buffer.
+static inline size_t buffer_size(ring_buffer_t *buffer) {
+    return RING_BUFFER_MASK(buffer) + 1;
+}
+
 void ring_buffer_init(ring_buffer_t *buffer, char *buf, size_t buf_size) {
     buffer->buffer = buf;
     buffer->buffer_mask = buf_size - 1;
@@ -43,42 +53,95 @@ void ring_buffer_queue(ring_buffer_t *buffer, const char data) {
 
     // Place data in buffer
     buffer->buffer[buffer->head_index] = data;
+    RING_BUFFER_BARRIER();
     buffer->head_index = ((buffer->head_index + 1) & RING_BUFFER_MASK(buffer));
 }
 
 void ring_buffer_queue_arr(ring_buffer_t *buffer, const char *data,
                            size_t size) {
-    // Add bytes; one by one
-    size_t i;
-    for (i = 0; i < size; i++) {
-        ring_buffer_queue(buffer, data[i]);
+    size_t room;
+
+    // Only the last bytes that fit in the buffer are kept.
+    if (size > RING_BUFFER_MASK(buffer)) {
+        data += size - RING_BUFFER_MASK(buffer);
+        size = RING_BUFFER_MASK(buffer);
     }
+
+    // Drop the oldest bytes to make room for the new ones.
+    room = RING_BUFFER_MASK(buffer) - ring_buffer_num_items(buffer);
+    if (size > room) {
+        buffer->tail_index =
+            (buffer->tail_index + size - room) & RING_BUFFER_MASK(buffer);
+    }
+
+    ring_buffer_try_queue_arr(buffer, data, size);
 }
 
-uint8_t ring_buffer_dequeue(ring_buffer_t *buffer, char *data) {
-    if (ring_buffer_is_empty(buffer)) {
-        // No items
+uint8_t ring_buffer_try_queue(ring_buffer_t *buffer, const char data) {
+    size_t head = buffer->head_index;
+
+    if (((head - buffer->tail_index) & RING_BUFFER_MASK(buffer)) ==
+        RING_BUFFER_MASK(buffer)) {
+        // No room left
         return 0;
     }
 
-    *data = buffer->buffer[buffer->tail_index];
-    buffer->tail_index = ((buffer->tail_index + 1) & RING_BUFFER_MASK(buffer));
+    // Publish the new head once the data is in place.
+    buffer->buffer[head] = data;
+    RING_BUFFER_BARRIER();
+    buffer->head_index = (head + 1) & RING_BUFFER_MASK(buffer);
     return 1;
 }
 
-size_t ring_buffer_dequeue_arr(ring_buffer_t *buffer, char *data, size_t len) {
-    char *data_ptr = data;
-    size_t cnt = 0;
+size_t ring_buffer_try_queue_arr(ring_buffer_t *buffer, const char *data,
+                                 size_t size) {
+    size_t head = buffer->head_index;
+    size_t room = RING_BUFFER_MASK(buffer) -
+                  ((head - buffer->tail_index) & RING_BUFFER_MASK(buffer));
+    size_t first;
+
+    size = min_size(size, room);
+
+    // Copy up to the end of the buffer, then wrap around.
+    first = min_size(size, buffer_size(buffer) - head);
+    memcpy(&buffer->buffer[head], data, first);
+    memcpy(buffer->buffer, data + first, size - first);
+
+    // Publish the new head once the data is in place.
+    RING_BUFFER_BARRIER();
+    buffer->head_index = (head + size) & RING_BUFFER_MASK(buffer);
+    return size;
+}
+
+uint8_t ring_buffer_dequeue(ring_buffer_t *buffer, char *data) {
+    size_t tail = buffer->tail_index;
 
-    if (ring_buffer_is_empty(buffer)) {
+    if (tail == buffer->head_index) {
         // No items
         return 0;
     }
 
-    while ((cnt < len) && ring_buffer_dequeue(buffer, data_ptr)) {
-        cnt++;
-        data_ptr++;
-    }
+    // Release the slot once the data is read.
+    *data = buffer->buffer[tail];
+    RING_BUFFER_BARRIER();
+    buffer->tail_index = (tail + 1) & RING_BUFFER_MASK(buffer);
+    return 1;
+}
+
+size_t ring_buffer_dequeue_arr(ring_buffer_t *buffer, char *data, size_t len) {
+    size_t tail = buffer->tail_index;
+    size_t cnt = min_size(
+        len, (buffer->head_index - tail) & RING_BUFFER_MASK(buffer));
+    size_t first;
+
+    // Copy up to the end of the buffer, then wrap around.
+    first = min_size(cnt, buffer_size(buffer) - tail);
+    memcpy(data, &buffer->buffer[tail], first);
+    memcpy(data + first, buffer->buffer, cnt - first);
+
+    // Release the slots once the data is read.
+    RING_BUFFER_BARRIER();
+    buffer->tail_index = (tail + cnt) & RING_BUFFER_MASK(buffer);
     return cnt;
 }
 
@@ -94,3 +157,30 @@ uint8_t ring_buffer_peek(ring_buffer_t *buffer, char *data, size_t index) {
     *data = buffer->buffer[data_index];
     return 1;
 }
+
+size_t ring_buffer_peek_contiguous(ring_buffer_t *buffer, const char **data) {
+    size_t tail = buffer->tail_index;
+
+    *data = &buffer->buffer[tail];
+    return min_size((buffer->head_index - tail) & RING_BUFFER_MASK(buffer),
+                    buffer_size(buffer) - tail);
+}
+
+void ring_buffer_commit_read(ring_buffer_t *buffer, size_t len) {
+    RING_BUFFER_BARRIER();
+    buffer->tail_index = (buffer->tail_index + len) & RING_BUFFER_MASK(buffer);
+}
+
+size_t ring_buffer_reserve_contiguous(ring_buffer_t *buffer, char **data) {
+    size_t head = buffer->head_index;
+    size_t room = RING_BUFFER_MASK(buffer) -
+                  ((head - buffer->tail_index) & RING_BUFFER_MASK(buffer));
+
+    *data = &buffer->buffer[head];
+    return min_size(room, buffer_size(buffer) - head);
+}
+
+void ring_buffer_commit_write(ring_buffer_t *buffer, size_t len) {
+    RING_BUFFER_BARRIER();
+    buffer->head_index = (buffer->head_index + len) & RING_BUFFER_MASK(buffer);
+}
@@ -36,22 +36,34 @@
 
 // Used as a modulo operator as a % b = (a & (b − 1)) where a is a positive
 // index in the buffer and b is the (power of two) size of the buffer.
-#define RING_BUFFER_MASK(rb) (rb->buffer_mask)
+#define RING_BUFFER_MASK(rb) ((rb)->buffer_mask)
+
+// Prevents the compiler from moving memory accesses across it. The kernel runs
+// on a single CPU, so ordering the accesses of the producer and the consumer
+// only requires a compiler barrier.
+#define RING_BUFFER_BARRIER() __asm__ __volatile__("" : : : "memory")
 
 // Simplifies the use of struct ring_buffer_t.
 typedef struct ring_buffer_t ring_buffer_t;
 
 // Structure which holds a ring buffer.  The buffer contains a buffer array as
 // well as metadata for the ring buffer.
+//
+// A ring buffer can be shared by a single producer and a single consumer
+// running concurrently, e.g. an interrupt handler and a task, without masking
+// interrupts: the producer only writes the head index, after the data, and the
+// consumer only writes the tail index, after reading the data. The producer
+// must then use the ring_buffer_try_queue*() functions, since the overwriting
+// ring_buffer_queue*() functions move the tail index.
 struct ring_buffer_t {
     // Buffer memory.
     char *buffer;
     // Buffer mask.
     size_t buffer_mask;
-    // Index of tail.
-    size_t tail_index;
-    // Index of head.
-    size_t head_index;
+    // Index of tail, only written by the consumer.
+    volatile size_t tail_index;
+    // Index of head, only written by the producer.
+    volatile size_t head_index;
 };
 
 // Initializes the ring buffer pointed to by <buffer>. This function can also be
@@ -61,18 +73,33 @@ struct ring_buffer_t {
 // @param buf_size The size of the allocated ringbuffer.
 void ring_buffer_init(ring_buffer_t *buffer, char *buf, size_t buf_size);
 
-// Adds a byte to a ring buffer.
+// Adds a byte to a ring buffer, overwriting the oldest byte if it is full.
 // @param buffer The buffer in which the data should be placed.
 // @param data The byte to place.
 void ring_buffer_queue(ring_buffer_t *buffer, const char data);
 
-// Adds an array of bytes to a ring buffer.
+// Adds an array of bytes to a ring buffer, overwriting the oldest bytes if
+// there is not enough room.
 // @param buffer The buffer in which the data should be placed.
 // @param data A pointer to the array of bytes to place in the queue.
 // @param size The size of the array.
 void ring_buffer_queue_arr(ring_buffer_t *buffer, const char *data,
                            size_t size);
 
+// Adds a byte to a ring buffer if it is not full.
+// @param buffer The buffer in which the data should be placed.
+// @param data The byte to place.
+// @return 1 if the byte was added; 0 if the buffer is full.
+uint8_t ring_buffer_try_queue(ring_buffer_t *buffer, const char data);
+
+// Adds as many bytes of an array as there is room for in a ring buffer.
+// @param buffer The buffer in which the data should be placed.
+// @param data A pointer to the array of bytes to place in the queue.
+// @param size The size of the array.
+// @return The number of bytes added, from the start of the array.
+size_t ring_buffer_try_queue_arr(ring_buffer_t *buffer, const char *data,
+                                 size_t size);
+
 // Returns the oldest byte in a ring buffer.
 // @param buffer The buffer from which the data should be returned.
 // @param data A pointer to the location at which the data should be placed.
@@ -93,6 +120,33 @@ size_t ring_buffer_dequeue_arr(ring_buffer_t *buffer, char *data, size_t len);
 // @return 1 if data was returned; 0 otherwise.
 uint8_t ring_buffer_peek(ring_buffer_t *buffer, char *data, size_t index);
 
+// Returns the oldest bytes of a ring buffer that are stored contiguously,
+// without removing them. The bytes are consumed with ring_buffer_commit_read().
+// @param buffer The buffer from which the data should be returned.
+// @param data Set to the location of the oldest byte.
+// @return The number of bytes readable at <data>, 0 if the buffer is empty.
+size_t ring_buffer_peek_contiguous(ring_buffer_t *buffer, const char **data);
+
+// Removes the <len> oldest bytes from a ring buffer.
+// @param buffer The buffer from which the data is removed.
+// @param len The number of bytes to remove, at most the value returned by the
+//        last call to ring_buffer_peek_contiguous().
+void ring_buffer_commit_read(ring_buffer_t *buffer, size_t len);
+
+// Returns the free space of a ring buffer that follows the last byte
+// contiguously. The bytes written there are added to the buffer with
+// ring_buffer_commit_write().
+// @param buffer The buffer in which the data should be placed.
+// @param data Set to the location following the newest byte.
+// @return The number of bytes writable at <data>, 0 if the buffer is full.
+size_t ring_buffer_reserve_contiguous(ring_buffer_t *buffer, char **data);
+
+// Adds the <len> bytes written after the newest byte to a ring buffer.
+// @param buffer The buffer in which the data was placed.
+// @param len The number of bytes to add, at most the value returned by the
+//        last call to ring_buffer_reserve_contiguous().
+void ring_buffer_commit_write(ring_buffer_t *buffer, size_t len);
+
 // Returns whether a ring buffer is empty.
 // @param buffer The buffer for which it should be returned whether it is empty.
 // @return 1 if empty; 0 otherwise.
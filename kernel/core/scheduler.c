@@ -2,16 +2,20 @@
 
 #include "scheduler.h"
 
-#include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 
+#include "cpu.h"
 #include "ctx.h"
 #include "error.h"
 #include "list.h"
+#include "softirq.h"
+#include "taskpool.h"
+#include "waitqueue.h"
 
 // Current running process.
 struct task *current;
@@ -19,86 +23,244 @@ struct task *current;
 // Next available PID.
 static pid_t next_pid;
 
-// List or ready processes ordered by decreasing priority.
-struct list_node ready = LIST_INITIAL_VALUE(ready);
+// Ready processes, one FIFO queue per priority level. Bit N of the bitmap is
+// set when the queue of level N is not empty.
+static struct {
+    uint16_t bitmap;
+    struct list_node queues[SCHED_PRIO_LEVELS];
+} ready;
+
+// Time slice of each priority level, in clock ticks.
+static uint8_t slices[SCHED_PRIO_LEVELS];
+
+// Set when the current process has to give up the CPU at the next preemption
+// point.
+static bool need_resched;
+
+// Number of processes preempted at a preemption point.
+static unsigned long preemptions;
+
+// Number of buckets of the PID hash table, a power of two.
+#define PID_HASH_SIZE 16
+#define PID_HASH(pid) ((unsigned int)(pid) & (PID_HASH_SIZE - 1))
+
+// Processes hashed by PID.
+static struct list_node pid_hash[PID_HASH_SIZE];
+
+// Process adopting the children of the processes that exit: the kernel main
+// process.
+static struct task *reaper;
+
+// List of all the processes, whatever their state.
+static struct list_node tasks = LIST_INITIAL_VALUE(tasks);
+
+// Clock measuring the CPU time of the processes.
+static struct {
+    uint32_t (*read)(void);
+    uint32_t freq;
+    // Clock value when the CPU time was last charged to a process.
+    uint32_t last;
+} clock;
+
+// Function writing the messages of a halting system.
+static int (*panic_write)(const char *buf, size_t len);
+
+// Function waking up the system from its idle state, called before switching
+// away from the idle task.
+static void (*idle_exit)(void);
+
+// ready_highest returns the highest priority level with ready processes. The
+// ready queues must not be empty.
+static int ready_highest(void) {
+    // Index of the most significant bit set in a nibble.
+    static const uint8_t msb[16] = {0, 0, 1, 1, 2, 2, 2, 2,
+                                    3, 3, 3, 3, 3, 3, 3, 3};
+    uint16_t map = ready.bitmap;
+    int level = 0;
+
+    if (map & 0xff00) {
+        map >>= 8;
+        level = 8;
+    }
+    if (map & 0xf0) {
+        map >>= 4;
+        level += 4;
+    }
+    return level + msb[map];
+}
 
-// List of killed processes. Not ordered.
-struct list_node zombies = LIST_INITIAL_VALUE(zombies);
+// ready_get removes the first process of the highest priority level from the
+// ready queues. The ready queues must not be empty.
+static struct task *ready_get(void) {
+    int level = ready_highest();
+    struct task *t =
+        list_remove_head_type(&ready.queues[level], struct task, node);
 
-// List of processes waiting for another to die.
-struct list_node waiters = LIST_INITIAL_VALUE(waiters);
+    if (list_is_empty(&ready.queues[level])) {
+        ready.bitmap &= ~(1u << level);
+    }
+    return t;
+}
 
-static inline struct task *task_get(struct list_node *list) {
-    return list_remove_head_type(list, struct task, node);
+// ready_put queues |task| behind the ready processes of the same priority. A
+// process that exhausted its time slice gets a new one, a preempted process
+// keeps what's left of its slice.
+static void ready_put(struct task *task) {
+    if (task->slice <= 0) {
+        task->slice = slices[task->prio];
+    }
+    list_add_tail(&ready.queues[task->prio], &task->node);
+    ready.bitmap |= 1u << task->prio;
 }
 
-static void task_put(struct list_node *list, struct task *task) {
-    struct task *t = NULL;
+// charge_cpu charges the CPU time elapsed since the last call to the current
+// process, as system time while it runs a syscall.
+static void charge_cpu(void) {
+    uint32_t now, delta;
 
-    if (list_is_empty(list)) {
-        list_add_before(list, &task->node);
+    if (!clock.read) {
         return;
     }
-
-    // If the task we want to add has a lower priority than anything else, just
-    // directly add it at the end of the list. It'll save a list traversal.
-    t = list_peek_tail_type(list, struct task, node);
-    if (t && t->prio >= task->prio) {
-        list_add_after(&t->node, &task->node);
-        return;
+    now = clock.read();
+    delta = now - clock.last;
+    clock.last = now;
+    if (current->syscalls) {
+        current->stime += delta;
+    } else {
+        current->utime += delta;
     }
+}
 
-    list_for_every_entry(list, t, struct task, node) {
-        if (t->prio < task->prio) {
-            list_add_before(&t->node, &task->node);
-            return;
-        }
+// task_attach makes |t| a child of the current process and makes it visible
+// by its PID.
+static void task_attach(struct task *t) {
+    wait_queue_init(&t->child_exit);
+    list_initialize(&t->children);
+    list_initialize(&t->zombies);
+    list_add_tail(&pid_hash[PID_HASH(t->pid)], &t->pid_node);
+    list_add_tail(&tasks, &t->tasks_node);
+    if (t != current) {
+        t->parent = current->pid;
+        list_add_tail(&current->children, &t->sibling_node);
+    } else {
+        t->parent = -1;
+        list_clear_node(&t->sibling_node);
     }
-
-    // We should never reach here.
-    assert(0);
 }
 
-struct task *task_find(struct list_node *list, pid_t pid) {
-    struct task *t;
-    list_for_every_entry(list, t, struct task, node) {
-        if (t->pid == pid) {
-            return t;
-        }
-    }
-    return NULL;
+// task_detach removes the exited process |t| from its parent and from the
+// processes.
+static void task_detach(struct task *t) {
+    list_delete(&t->node);
+    list_delete(&t->sibling_node);
+    list_delete(&t->pid_node);
+    list_delete(&t->tasks_node);
 }
 
-struct task *task_find_child_of(struct list_node *list, pid_t pid) {
+// task_reparent gives the children of the current process, and its exited
+// children not waited for, to the reaper.
+static void task_reparent(void) {
     struct task *t;
-    list_for_every_entry(list, t, struct task, node) {
-        if (t->parent == pid) {
-            return t;
-        }
+
+    while ((t = list_remove_head_type(&current->children, struct task,
+                                      sibling_node))) {
+        t->parent = reaper->pid;
+        list_add_tail(&reaper->children, &t->sibling_node);
     }
-    return NULL;
+    if (list_is_empty(&current->zombies)) {
+        return;
+    }
+    while ((t = list_remove_head_type(&current->zombies, struct task, node))) {
+        list_add_tail(&reaper->zombies, &t->node);
+    }
+    wait_queue_wake_all(&reaper->child_exit);
 }
 
 void scheduler_initialize() {
+    ready.bitmap = 0;
+    for (int level = 0; level < SCHED_PRIO_LEVELS; level++) {
+        list_initialize(&ready.queues[level]);
+        slices[level] = SCHED_SLICE_DEFAULT;
+    }
+    need_resched = false;
+    idle_exit = NULL;
+    panic_write = NULL;
+    preemptions = 0;
+    for (int i = 0; i < PID_HASH_SIZE; i++) {
+        list_initialize(&pid_hash[i]);
+    }
+    list_initialize(&tasks);
+
     // Current kernel task runnning with a standard priority.
     current = calloc(1, sizeof(struct task));
     current->pid = next_pid++;
-    current->parent = -1;
     current->state = RUNNING;
-    current->prio = 0;
+    current->prio = SCHED_PRIO_DEFAULT;
+    current->slice = slices[current->prio];
     list_initialize(&current->node);
+    task_attach(current);
+    task_init_desc(current);
+    reaper = current;
+}
+
+// stack_check halts the system if the process |t| overflowed its stack: the
+// memory below the stack is corrupted.
+static void stack_check(struct task *t) {
+    char msg[64];
+
+    if (!t->stack || stack_intact(t->stack)) {
+        return;
+    }
+    // Nothing can be trusted anymore: no interrupt, no process switch, the
+    // message is written without buffers nor sleeps.
+    cli();
+    snprintf(msg, sizeof(msg),
+             "sched: process %d overflowed its %u bytes stack\n", t->pid,
+             (unsigned int)t->stack_size);
+    if (panic_write) {
+        panic_write(msg, strlen(msg));
+    }
+    while (1) {
+        hlt();
+    }
 }
 
 void schedule() {
     struct task *prev, *next;
 
-    if (!current || list_is_empty(&ready)) {
-        // Scheduler not initialized or the ready list is empty, nothing to do.
+    if (!current) {
+        // Scheduler not initialized, nothing to do.
+        return;
+    }
+    stack_check(current);
+    need_resched = false;
+
+    // A running process keeps the CPU until a process of the same or a higher
+    // priority is ready. It starts a new slice if it exhausted its own.
+    if (current->state == RUNNING &&
+        (!ready.bitmap || current->prio > ready_highest())) {
+        if (current->slice <= 0) {
+            current->slice = slices[current->prio];
+        }
+        return;
+    }
+    if (!ready.bitmap) {
+        // The ready list is empty, nothing to do.
         return;
     }
 
-    // Get the next process to run.
-    next = task_get(&ready);
+    // Get the next process to run, its stack may have been corrupted while it
+    // was waiting.
+    next = ready_get();
+    stack_check(next);
+
+    // The outgoing process either gave up the CPU or got preempted.
+    charge_cpu();
+    if (current->state == RUNNING) {
+        current->nivcsw++;
+    } else {
+        current->nvcsw++;
+    }
 
     // Switch processes internally.
     prev = current;
@@ -108,7 +270,12 @@ void schedule() {
     // future run.
     if (prev->state == RUNNING) {
         prev->state = READY;
-        task_put(&ready, prev);
+        ready_put(prev);
+    }
+
+    // Whatever the preemption point, the idle state ends with the idle task.
+    if (prev->prio == SCHED_PRIO_IDLE && idle_exit) {
+        idle_exit();
     }
 
     // Switch to the next process.
@@ -116,17 +283,74 @@ void schedule() {
     ctx_switch(&prev->ctx, &next->ctx);
 }
 
+int scheduler_set_slice(int prio, int ticks) {
+    if (prio < SCHED_PRIO_IDLE || prio > SCHED_PRIO_MAX || ticks < 1 ||
+        ticks > SCHED_SLICE_MAX) {
+        return ERR_INVAL;
+    }
+    slices[prio] = ticks;
+    return 0;
+}
+
+void scheduler_tick(void) {
+    if (!current) {
+        return;
+    }
+    if (--current->slice <= 0) {
+        need_resched = true;
+    }
+}
+
+void scheduler_preempt(void) {
+    struct task *prev = current;
+
+    // Don't switch tasks in the middle of deferred work an interrupt
+    // interrupted.
+    if (!need_resched || softirq_active()) {
+        return;
+    }
+    schedule();
+    if (current != prev) {
+        preemptions++;
+    }
+}
+
+unsigned long scheduler_preemptions(void) { return preemptions; }
+
 struct task *scheduler_current(void) { return current; }
 
+struct task *scheduler_find(pid_t pid) {
+    struct task *t;
+
+    list_for_every_entry(&pid_hash[PID_HASH(pid)], t, struct task, pid_node) {
+        if (t->pid == pid) {
+            return t;
+        }
+    }
+    return NULL;
+}
+
 int scheduler_queue_new(struct task *t, int prio) {
+    int err;
+
+    if (prio < SCHED_PRIO_IDLE || prio > SCHED_PRIO_MAX) {
+        return ERR_INVAL;
+    }
+
+    // Give the task its console descriptors.
+    err = task_init_desc(t);
+    if (err < 0) {
+        return err;
+    }
+
     // Initialize the process structure.
     t->pid = next_pid++;
-    t->parent = current->pid;
     t->prio = prio;
     t->state = READY;
+    task_attach(t);
 
     // Add the task to the ready list.
-    task_put(&ready, t);
+    ready_put(t);
 
     return t->pid;
 }
@@ -136,7 +360,7 @@ void scheduler_exit(int status) {
         // Scheduler not initialized, nothing to do.
         return;
     }
-    if (current->pid == 0) {
+    if (current == reaper) {
         printf("scheduler: can't exit kernel main process\n");
         return;
     }
@@ -145,26 +369,13 @@ void scheduler_exit(int status) {
     current->state = ZOMBIE;
     current->status = status;
 
-    // Process exited, let other processes wait on it.
-    list_add_before(&zombies, &current->node);
-
-    // Wake-up any process waiting for this one to die.
-    struct task *t, *tmp;
-    list_for_every_entry_safe(&waiters, t, tmp, struct task, node) {
-        pid_t pid = *(pid_t *)t->wait_state;
-        // The waiter explicitely waits for this task.
-        if (pid > 0 && current->pid == pid) {
-            list_delete(&t->node);
-            scheduler_wake_up(t);
-            break;
-        }
-        // The waiter is a parent and waits for one of its children.
-        if (pid == -1 && t->pid == current->parent) {
-            list_delete(&t->node);
-            scheduler_wake_up(t);
-            break;
-        }
-    }
+    // Orphans are adopted by the reaper.
+    task_reparent();
+
+    // Process exited, let its parent wait on it.
+    struct task *parent = scheduler_find(current->parent);
+    list_add_tail(&parent->zombies, &current->node);
+    wait_queue_wake_all(&parent->child_exit);
 
     schedule();
 }
@@ -176,59 +387,184 @@ pid_t scheduler_getpid() {
     return current->pid;
 }
 
+// Child a process waits for, see scheduler_wait.
+struct wait_child {
+    // Child to wait for, NULL for any child.
+    struct task *child;
+    // Child that exited, NULL until one does.
+    struct task *zombie;
+};
+
+// child_exited tells if the child awaited by |arg|, a struct wait_child,
+// exited.
+static bool child_exited(void *arg) {
+    struct wait_child *w = arg;
+
+    if (!w->child) {
+        w->zombie = list_peek_head_type(&current->zombies, struct task, node);
+    } else if (w->child->state == ZOMBIE) {
+        w->zombie = w->child;
+    }
+    return w->zombie != NULL;
+}
+
 pid_t scheduler_wait(pid_t pid, int *wstatus, int options,
                      struct rusage *usage) {
-    // rusage is not used for now.
-    (void)usage;
+    struct wait_child w = {NULL, NULL};
 
     if (pid < -1) {
         return ERR_NOT_SUPP;
     }
-
-    struct task *t = NULL;
-    do {
-        // Find the task we're waiting for.
-        if (pid == -1) {
-            t = task_find_child_of(&zombies, current->pid);
-        } else {
-            t = task_find(&zombies, pid);
-        }
-        // Task not found, and the call is non blocking.
-        if (!t && (options & WNOHANG)) {
-            // TODO: check the ready list.
-            return 0;
+    if (pid == -1) {
+        if (list_is_empty(&current->children)) {
+            return ERR_NO_ENTRY;
         }
-        // Task not found, block until (one of) the expected one(s) dies.
-        if (!t) {
-            scheduler_sleep_on(&waiters, &pid);
+    } else {
+        w.child = scheduler_find(pid);
+        if (!w.child || w.child->parent != current->pid) {
+            return ERR_NO_ENTRY;
         }
+    }
 
-    } while (!t);
+    if (options & WNOHANG) {
+        if (!child_exited(&w)) {
+            return 0;
+        }
+    } else {
+        // Exiting children wake up their parent.
+        wait_queue_wait(&current->child_exit, child_exited, &w);
+    }
 
+    struct task *t = w.zombie;
     pid_t dead_pid = t->pid;
     if (wstatus) {
         *wstatus = (t->status & 0xff) << 8;
     }
+    if (usage) {
+        scheduler_rusage(t, usage);
+    }
 
-    free(t->stack);
-    free(t);
+    task_detach(t);
+    free(t->descriptors);
+    if (t->stack) {
+        stack_release(t->stack, t->stack_size);
+    }
+    task_release(t);
     return dead_pid;
 }
 
-void scheduler_sleep_on(struct list_node *queue, void *sleep_data) {
+void scheduler_sleep_on(struct list_node *queue) {
     if (!queue) {
         return;
     }
     current->state = WAITING;
-    current->wait_state = sleep_data;
     list_add_before(queue, &current->node);
     schedule();
 }
 
+bool scheduler_may_sleep(void) {
+    return current && current->prio != SCHED_PRIO_IDLE && !softirq_active();
+}
+
 void scheduler_wake_up(struct task *task) {
     if (!task) {
         return;
     }
     task->state = READY;
-    task_put(&ready, task);
+    ready_put(task);
+
+    // Don't let a process of a higher priority wait for the end of the slice.
+    if (current && task->prio > current->prio) {
+        need_resched = true;
+    }
+}
+
+void scheduler_set_clock(uint32_t (*read)(void), uint32_t freq) {
+    clock.read = read;
+    clock.freq = freq;
+    if (read) {
+        clock.last = read();
+    }
+}
+
+void scheduler_set_panic_write(int (*write)(const char *buf, size_t len)) {
+    panic_write = write;
+}
+
+void scheduler_set_idle_exit(void (*fn)(void)) { idle_exit = fn; }
+
+void scheduler_syscall_enter(void) {
+    if (!current) {
+        return;
+    }
+    charge_cpu();
+    current->syscalls++;
+}
+
+void scheduler_syscall_exit(void) {
+    if (!current) {
+        return;
+    }
+    charge_cpu();
+    current->syscalls--;
+}
+
+// counts_to_timeval converts a number of clock |counts| into |tv|.
+static void counts_to_timeval(uint64_t counts, struct timeval *tv) {
+    uint64_t us = counts * 1000000 / clock.freq;
+
+    tv->tv_sec = us / 1000000;
+    tv->tv_usec = us % 1000000;
+}
+
+// counts_to_ms converts a number of clock |counts| into milliseconds.
+static unsigned long counts_to_ms(uint64_t counts) {
+    return counts * 1000 / clock.freq;
+}
+
+void scheduler_rusage(const struct task *task, struct rusage *usage) {
+    memset(usage, 0, sizeof(*usage));
+    if (clock.freq) {
+        counts_to_timeval(task->utime, &usage->ru_utime);
+        counts_to_timeval(task->stime, &usage->ru_stime);
+    }
+    usage->ru_nvcsw = task->nvcsw;
+    usage->ru_nivcsw = task->nivcsw;
+}
+
+void scheduler_dump(void) {
+    static const char *const states[] = {"ready", "run", "wait", "zombie"};
+    struct task *t;
+    uint64_t total = 0;
+
+    if (!clock.freq) {
+        printf("sched: no clock to measure the CPU time\n");
+        return;
+    }
+
+    // Bring the time of the running process up to date.
+    charge_cpu();
+    list_for_every_entry(&tasks, t, struct task, tasks_node) {
+        total += t->utime + t->stime;
+    }
+
+    printf("sched: %lu preemptions\n", preemptions);
+    printf(
+        "  PID  PPID PRIO STATE    USER(ms)   SYS(ms)   VCSW  IVCSW CPU%%  "
+        "STACK\n");
+    list_for_every_entry(&tasks, t, struct task, tasks_node) {
+        unsigned int cpu =
+            total ? (unsigned int)((t->utime + t->stime) * 100 / total) : 0;
+        printf("%5d %5d %4d %-6s %10lu %9lu %6lu %6lu %3u", t->pid, t->parent,
+               t->prio, states[t->state], counts_to_ms(t->utime),
+               counts_to_ms(t->stime), t->nvcsw, t->nivcsw, cpu);
+        // Deepest use of the stack so far, and its size.
+        if (t->stack) {
+            printf("  %4u/%u\n",
+                   (unsigned int)stack_high_water(t->stack, t->stack_size),
+                   (unsigned int)t->stack_size);
+        } else {
+            printf("     -\n");
+        }
+    }
 }
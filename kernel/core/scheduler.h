@@ -3,40 +3,113 @@
 #ifndef _SCHEDULER_H_
 #define _SCHEDULER_H_
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <sys/resource.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
 #include "task.h"
 
+// Number of priority levels. Processes of the highest level with ready
+// processes run first, processes of the same level run in turn.
+#define SCHED_PRIO_LEVELS 16
+// Priority of the idle task, it runs only when nothing else is ready.
+#define SCHED_PRIO_IDLE 0
+// Priority of the kernel main process.
+#define SCHED_PRIO_DEFAULT 8
+// Highest priority.
+#define SCHED_PRIO_MAX (SCHED_PRIO_LEVELS - 1)
+// Default time slice of every priority level, in clock ticks.
+#define SCHED_SLICE_DEFAULT 2
+// Longest time slice, in clock ticks.
+#define SCHED_SLICE_MAX 255
+
 // scheduler_initialize prepares the scheduler to manage threads and processes.
 void scheduler_initialize(void);
 
 // scheduler_queue_new queues a new task into the scheduler ready list with
-// |prio| priority. Returns the PID of the newly started process.
+// |prio| priority, between SCHED_PRIO_IDLE and SCHED_PRIO_MAX. Returns the PID
+// of the newly started process, or a negative error code.
 int scheduler_queue_new(struct task *t, int prio);
 
 // scheduler_exit quits the calling process and store the process return code
-// |status|.
+// |status|. Its children are adopted by the kernel main process.
 void scheduler_exit(int status);
 
 // schedule stops the current process and runs the next one.
 void schedule(void);
 
+// scheduler_set_slice sets to |ticks| the time slice of the processes of
+// priority |prio|, used from their next slice. Returns 0 on success, ERR_INVAL
+// if the priority or the slice is out of range.
+int scheduler_set_slice(int prio, int ticks);
+
+// scheduler_tick charges a clock tick to the time slice of the current process.
+void scheduler_tick(void);
+
+// scheduler_preempt switches to the next process if the current one exhausted
+// its time slice or if a process of a higher priority became ready. Called by
+// interrupt handlers once their deferred work is done.
+void scheduler_preempt(void);
+
+// scheduler_preemptions returns the number of times a process got preempted.
+unsigned long scheduler_preemptions(void);
+
 // scheduler_current returns the task currently runnning.
 struct task *scheduler_current(void);
 
+// scheduler_find returns the process with |pid|, running or exited, NULL if
+// there's none.
+struct task *scheduler_find(pid_t pid);
+
 // scheduler_getpid returns the process ID of the process currently running.
 pid_t scheduler_getpid();
 
-// scheduler_waitid waits for the a process.
+// scheduler_waitid waits for the child process |id| to exit, or for any child
+// if |id| is -1. The resources used by the process are stored in |usage| if not
+// NULL. Returns the PID of the child, 0 if none exited and |options| has
+// WNOHANG, ERR_NO_ENTRY if there's no such child.
 pid_t scheduler_wait(pid_t id, int *wstatus, int options, struct rusage *usage);
 
-// scheduler_sleep_on puts the current process to waiting state, put it in
-// |queue| and sets |sleep_data| as its wait_state.
-void scheduler_sleep_on(struct list_node *queue, void *sleep_data);
+// scheduler_sleep_on puts the current process to waiting state and put it in
+// |queue|. Use the wait queues instead, see waitqueue.h.
+void scheduler_sleep_on(struct list_node *queue);
+
+// scheduler_may_sleep tells if the current process can sleep: it is not the
+// idle task, and no deferred interrupt work is running on its stack.
+bool scheduler_may_sleep(void);
 
-// scheduler_wake_up puts |task| in the ready list for later scheduling.
+// scheduler_wake_up puts |task|, removed from the queue it slept on, in the
+// ready list for later scheduling.
 void scheduler_wake_up(struct task *task);
 
+// scheduler_set_clock sets the clock used to measure the CPU time of the
+// processes: |read| returns a free running counter incremented |freq| times
+// per second. No time is accounted until it's set.
+void scheduler_set_clock(uint32_t (*read)(void), uint32_t freq);
+
+// scheduler_set_panic_write sets |write|, used to report a corrupted process
+// before the system halts. It's called with interrupts disabled and must
+// neither sleep nor buffer the message. NULL disables it.
+void scheduler_set_panic_write(int (*write)(const char *buf, size_t len));
+
+// scheduler_set_idle_exit sets |fn|, called with interrupts disabled whenever
+// the idle task gives up the CPU, to leave the power saving state it entered.
+// NULL disables it.
+void scheduler_set_idle_exit(void (*fn)(void));
+
+// scheduler_syscall_enter and scheduler_syscall_exit delimit the syscalls of
+// the current process: the CPU time spent in between is system time.
+void scheduler_syscall_enter(void);
+void scheduler_syscall_exit(void);
+
+// scheduler_rusage fills |usage| with the CPU time and context switches of
+// |task|.
+void scheduler_rusage(const struct task *task, struct rusage *usage);
+
+// scheduler_dump prints the state and the CPU usage of every process.
+void scheduler_dump(void);
+
 #endif  // _SCHEDULER_H_
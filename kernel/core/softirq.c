@@ -0,0 +1,46 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+
+#include "softirq.h"
+
+#include <stdbool.h>
+
+#include "cpu.h"
+#include "list.h"
+
+// Tasklets waiting to run.
+static struct list_node pending = LIST_INITIAL_VALUE(pending);
+// Set while softirq_run() runs the tasklets.
+static bool active;
+
+void tasklet_init(struct tasklet *t, void (*func)(void *arg), void *arg) {
+    list_clear_node(&t->node);
+    t->func = func;
+    t->arg = arg;
+}
+
+void tasklet_schedule(struct tasklet *t) {
+    if (!list_in_list(&t->node)) {
+        list_add_tail(&pending, &t->node);
+    }
+}
+
+void softirq_run(void) {
+    struct tasklet *t;
+
+    // Nested interrupt: the outer call runs the new tasklets.
+    if (active) {
+        return;
+    }
+
+    active = true;
+    while ((t = list_remove_head_type(&pending, struct tasklet, node))) {
+        // The tasklet is removed first so that it can be scheduled again
+        // while it runs.
+        sti();
+        t->func(t->arg);
+        cli();
+    }
+    active = false;
+}
+
+bool softirq_active(void) { return active; }
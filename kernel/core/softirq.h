@@ -0,0 +1,48 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+//
+// Deferred interrupt work. Interrupt handlers do the minimum with interrupts
+// disabled: acknowledge the device, capture its state and schedule a tasklet.
+// Tasklets run with interrupts enabled once the handler is done, before
+// returning to the interrupted task.
+//
+// Tasklets and code running with interrupts disabled, like the syscalls, never
+// interleave: tasklets can safely use the scheduler and the data shared with
+// the syscalls. Interrupt handlers must not touch them anymore.
+
+#ifndef _SOFTIRQ_H_
+#define _SOFTIRQ_H_
+
+#include <stdbool.h>
+
+#include "list.h"
+
+struct tasklet {
+    // Node in the pending tasklets list.
+    struct list_node node;
+    // Deferred work and its argument.
+    void (*func)(void *arg);
+    void *arg;
+};
+
+#define TASKLET_INITIAL_VALUE(fn, data) \
+    { .node = LIST_INITIAL_CLEARED_VALUE, .func = (fn), .arg = (data) }
+
+// tasklet_init prepares <t> to run <func> with <arg>.
+void tasklet_init(struct tasklet *t, void (*func)(void *arg), void *arg);
+
+// tasklet_schedule queues <t> to run after the current interrupt handler. A
+// tasklet already pending runs once. It must be called with interrupts
+// disabled.
+void tasklet_schedule(struct tasklet *t);
+
+// softirq_run runs the pending tasklets with interrupts enabled. It is called
+// by the interrupt handlers once the interrupt is acknowledged, with interrupts
+// disabled, and returns with interrupts disabled. When an interrupt arrives
+// while tasklets run, its tasklets are run by the outer call.
+void softirq_run(void);
+
+// softirq_active tells if tasklets are running. The interrupted task must not
+// be switched while they are.
+bool softirq_active(void);
+
+#endif  // _SOFTIRQ_H_
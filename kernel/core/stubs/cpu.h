@@ -0,0 +1,12 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+
+#ifndef _CPU_H_
+#define _CPU_H_
+
+static inline void cli(void) {}
+
+static inline void sti(void) {}
+
+static inline void hlt(void) {}
+
+#endif  // _CPU_H_
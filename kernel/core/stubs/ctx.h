@@ -3,7 +3,11 @@
 #ifndef _CTX_H_
 #define _CTX_H_
 
-struct context {};
+// Not empty: an empty struct has no size in C but one byte in C++, the tests
+// and the code under test must agree on the layout of struct task.
+struct context {
+    int unused;
+};
 
 void ctx_switch(struct context *prev, struct context *next);
 
@@ -15,6 +15,9 @@ void task_set_desc(struct descriptor *d, desc_t type, void *handle) {
         case DESC_DIR:
             d->handle.dir = handle;
             break;
+        case DESC_CONSOLE:
+            // The console is unique, there is no handle.
+            break;
         default:
             // TODO: throw an error.
             return;
@@ -22,10 +25,21 @@ void task_set_desc(struct descriptor *d, desc_t type, void *handle) {
     return;
 }
 
-int task_put_desc(struct task *t, desc_t type, void *handle) {
+int task_init_desc(struct task *t) {
+    t->descriptors = calloc(MAX_FD, sizeof(struct descriptor));
     if (!t->descriptors) {
-        // Table is not allocated yet.
-        t->descriptors = calloc(MAX_FD, sizeof(desc_t));
+        return ERR_NO_MEM;
+    }
+    for (int i = 0; i < CONSOLE_FDS; i++) {
+        task_set_desc(&(t->descriptors[i]), DESC_CONSOLE, NULL);
+    }
+    return 0;
+}
+
+int task_put_desc(struct task *t, desc_t type, void *handle) {
+    // Allocate the table if it's not done yet.
+    if (!t->descriptors && task_init_desc(t) < 0) {
+        return ERR_NO_MEM;
     }
     for (int i = 0; i < MAX_FD; i++) {
         if (t->descriptors[i].type == DESC_UNSET) {
@@ -38,7 +52,7 @@ int task_put_desc(struct task *t, desc_t type, void *handle) {
 }
 
 const struct descriptor *task_get_desc(struct task *t, int fd) {
-    if (!t->descriptors) {
+    if (!t->descriptors || fd < 0 || fd >= MAX_FD) {
         return NULL;
     }
     if (t->descriptors[fd].type != DESC_UNSET) {
@@ -3,11 +3,14 @@
 #ifndef _TASK_H_
 #define _TASK_H_
 
+#include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 #include "ctx.h"
 #include "fs.h"
 #include "list.h"
+#include "waitqueue.h"
 
 // Process state.
 enum task_state {
@@ -20,8 +23,9 @@ enum task_state {
 // File descriptor types.
 typedef enum {
     DESC_UNSET = 0,
-    DESC_FILE,  // Descriptor for a file.
-    DESC_DIR,   // Descriptor for a directory.
+    DESC_FILE,     // Descriptor for a file.
+    DESC_DIR,      // Descriptor for a directory.
+    DESC_CONSOLE,  // Descriptor for the console.
 
     DESC_MAX,
 } desc_t;
@@ -38,6 +42,8 @@ struct descriptor {
 
 // Maximum number of file descriptors.
 #define MAX_FD 16
+// Descriptors 0, 1 and 2 of every task are bound to the console.
+#define CONSOLE_FDS 3
 
 // Represents a process.
 struct task {
@@ -50,24 +56,49 @@ struct task {
     pid_t pid;
     // Parent process ID.
     pid_t parent;
-    // Process priority.
+    // Process priority level, see SCHED_PRIO_LEVELS.
     int prio;
+    // Clock ticks left in the time slice of the process.
+    int slice;
     // Process context.
     struct context ctx;
     // Process return value.
     int status;
 
-    // Process stack.
+    // Process stack and its size, see taskpool.h.
     void *stack;
-
-    // Private data use for wait condition.
-    void *wait_state;
+    size_t stack_size;
+
+    // Queue the process sleeps on while waiting for its children to exit.
+    struct wait_queue child_exit;
+    // Children of the process, running or exited, linked by their
+    // sibling_node.
+    struct list_node children;
+    struct list_node sibling_node;
+    // Exited children not waited for yet, linked by their node.
+    struct list_node zombies;
+    // Node in the PID hash table.
+    struct list_node pid_node;
 
     // Table of file descriptors associated to this task.
     struct descriptor *descriptors;
+
+    // List node of all the processes.
+    struct list_node tasks_node;
+    // Number of nested syscalls the process is running.
+    int syscalls;
+    // CPU time spent outside and inside syscalls, in scheduler clock counts.
+    uint64_t utime;
+    uint64_t stime;
+    // Number of times the process gave up the CPU, and was preempted.
+    unsigned long nvcsw;
+    unsigned long nivcsw;
 };
 
-#define WAIT_STATE(t, type) ((type *)t->wait_state)
+// task_init_desc allocates the descriptors table of |t| and binds the console
+// descriptors. Returns 0 on success, ERR_NO_MEM if the table can't be
+// allocated.
+int task_init_desc(struct task *t);
 
 // task_put_fd adds |handle| of |type| in |t| descriptors table.
 int task_put_desc(struct task *t, desc_t type, void *handle);
@@ -0,0 +1,159 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+
+#include "taskpool.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "list.h"
+#include "task.h"
+
+// Free objects of the same kind and size.
+struct pool {
+    struct list_node free;
+    int count;
+};
+
+#define POOL_INITIAL_VALUE(p) \
+    { .free = LIST_INITIAL_VALUE((p).free), .count = 0 }
+
+#if STACK_CLASSES != 4
+#error "stack_pools must have one pool per stack class"
+#endif
+
+// Free process structures, linked by their node.
+static struct pool task_pool = POOL_INITIAL_VALUE(task_pool);
+
+// Free stacks of each size class, linked by a node at the bottom of the
+// stacks.
+static struct pool stack_pools[STACK_CLASSES] = {
+    POOL_INITIAL_VALUE(stack_pools[0]),
+    POOL_INITIAL_VALUE(stack_pools[1]),
+    POOL_INITIAL_VALUE(stack_pools[2]),
+    POOL_INITIAL_VALUE(stack_pools[3]),
+};
+
+struct task *task_alloc(void) {
+    struct task *t = list_remove_head_type(&task_pool.free, struct task, node);
+
+    if (!t) {
+        return calloc(1, sizeof(*t));
+    }
+    task_pool.count--;
+    memset(t, 0, sizeof(*t));
+    return t;
+}
+
+void task_release(struct task *t) {
+    if (task_pool.count >= TASKPOOL_MAX_FREE) {
+        free(t);
+        return;
+    }
+    list_add_head(&task_pool.free, &t->node);
+    task_pool.count++;
+}
+
+// stack_class returns the size class of the stacks of <size> bytes, -1 if
+// they're too large for the pools.
+static int stack_class(size_t size) {
+    size_t class_size = STACK_MIN_SIZE;
+    int c = 0;
+
+    while (class_size < size) {
+        if (++c == STACK_CLASSES) {
+            return -1;
+        }
+        class_size <<= 1;
+    }
+    return c;
+}
+
+// stack_new allocates a painted stack of <size> bytes from the heap.
+static void *stack_new(size_t size) {
+    void *stack = malloc(size);
+
+    if (stack) {
+        memset(stack, STACK_PAINT, size);
+    }
+    return stack;
+}
+
+// stack_put adds the painted <stack> to the free stacks of class <c>.
+static void stack_put(void *stack, int c) {
+    list_add_head(&stack_pools[c].free, (struct list_node *)stack);
+    stack_pools[c].count++;
+}
+
+void *stack_alloc(size_t *size) {
+    int c = stack_class(*size);
+    void *stack = NULL;
+
+    if (c >= 0) {
+        *size = STACK_MIN_SIZE << c;
+        stack = list_remove_head(&stack_pools[c].free);
+    }
+    if (stack) {
+        // Only the free list node left a trace on the painted stack.
+        stack_pools[c].count--;
+        memset(stack, STACK_PAINT, sizeof(struct list_node));
+    } else {
+        stack = stack_new(*size);
+        if (!stack) {
+            return NULL;
+        }
+    }
+    *(uint16_t *)stack = STACK_CANARY;
+    return stack;
+}
+
+void stack_release(void *stack, size_t size) {
+    int c = stack_class(size);
+    size_t used;
+
+    if (c < 0 || stack_pools[c].count >= TASKPOOL_MAX_FREE) {
+        free(stack);
+        return;
+    }
+    // Paint again the part of the stack that was used.
+    used = stack_high_water(stack, size);
+    memset((uint8_t *)stack + size - used, STACK_PAINT, used);
+    stack_put(stack, c);
+}
+
+bool stack_intact(const void *stack) {
+    return *(const uint16_t *)stack == STACK_CANARY;
+}
+
+size_t stack_high_water(const void *stack, size_t size) {
+    const uint8_t *end = (const uint8_t *)stack + size;
+    const uint8_t *p = (const uint8_t *)stack + sizeof(uint16_t);
+
+    while (p < end && *p == STACK_PAINT) {
+        p++;
+    }
+    return end - p;
+}
+
+void taskpool_reserve(size_t size, int count) {
+    int c = stack_class(size);
+    struct task *t;
+    void *stack;
+
+    for (int i = 0; i < count; i++) {
+        if (task_pool.count < TASKPOOL_MAX_FREE) {
+            t = malloc(sizeof(*t));
+            if (t) {
+                task_release(t);
+            }
+        }
+        if (c >= 0 && stack_pools[c].count < TASKPOOL_MAX_FREE) {
+            stack = stack_new(STACK_MIN_SIZE << c);
+            if (stack) {
+                stack_put(stack, c);
+            }
+        }
+    }
+}
@@ -0,0 +1,62 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+//
+// Pools of process structures and stacks. Released objects are kept in free
+// lists to start the next processes without going through the heap. Stacks are
+// sorted in size classes, from STACK_MIN_SIZE to STACK_MAX_SIZE bytes, larger
+// ones come from the heap.
+//
+// Stacks grow down. The lowest word of a stack holds a canary overwritten when
+// the stack overflows, and the unused part of a stack is painted with
+// STACK_PAINT to measure how deep the stack went.
+//
+// The pools must be used with interrupts disabled.
+
+#ifndef _TASKPOOL_H_
+#define _TASKPOOL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "task.h"
+
+// Number of stack size classes, each twice the size of the previous one.
+#define STACK_CLASSES 4
+#define STACK_MIN_SIZE 256
+#define STACK_MAX_SIZE (STACK_MIN_SIZE << (STACK_CLASSES - 1))
+// Value of the canary at the bottom of the stacks.
+#define STACK_CANARY 0x57ac
+// Byte filling the unused part of the stacks.
+#define STACK_PAINT 0xa5
+// Maximum number of free objects kept by each pool, the others go back to the
+// heap.
+#define TASKPOOL_MAX_FREE 8
+
+// task_alloc returns a process structure cleared to zero, NULL if the memory
+// is exhausted.
+struct task *task_alloc(void);
+
+// task_release gives back the process structure <t>.
+void task_release(struct task *t);
+
+// stack_alloc returns a painted stack of at least <*size> bytes, with its
+// canary set, and stores its actual size in <*size>. Returns NULL if the memory
+// is exhausted.
+void *stack_alloc(size_t *size);
+
+// stack_release gives back <stack> of <size> bytes, as returned by
+// stack_alloc.
+void stack_release(void *stack, size_t size);
+
+// stack_intact tells if the canary of <stack> is still in place.
+bool stack_intact(const void *stack);
+
+// stack_high_water returns the maximum number of bytes used so far on <stack>
+// of <size> bytes.
+size_t stack_high_water(const void *stack, size_t size);
+
+// taskpool_reserve allocates <count> process structures and stacks of <size>
+// bytes ahead, for the next processes to start.
+void taskpool_reserve(size_t size, int count);
+
+#endif  // _TASKPOOL_H_
@@ -0,0 +1,177 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+extern "C" {
+#include "ktimer.h"
+}
+
+static std::vector<int> fired;
+
+static void record(void *arg) { fired.push_back(*(int *)arg); }
+
+class KtimerTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        fired.clear();
+        ktimer_initialize(100);
+    }
+};
+
+TEST_F(KtimerTest, FiresAtExpiration) {
+    int id = 1;
+    struct ktimer t = KTIMER_INITIAL_VALUE(record, &id);
+
+    ktimer_add(&t, 105);
+    EXPECT_TRUE(ktimer_pending(&t));
+    ktimer_run(104);
+    EXPECT_TRUE(fired.empty());
+    ktimer_run(105);
+    EXPECT_EQ(std::vector<int>({1}), fired);
+    EXPECT_FALSE(ktimer_pending(&t));
+    EXPECT_EQ(105u, ktimer_now());
+}
+
+TEST_F(KtimerTest, FiresInOrder) {
+    int ids[] = {1, 2, 3};
+    struct ktimer timers[3];
+
+    for (int i = 0; i < 3; i++) {
+        ktimer_init(&timers[i], record, &ids[i]);
+    }
+    ktimer_add(&timers[0], 110);
+    ktimer_add(&timers[1], 102);
+    ktimer_add(&timers[2], 106);
+
+    // Several ticks are processed at once.
+    ktimer_run(120);
+    EXPECT_EQ(std::vector<int>({2, 3, 1}), fired);
+}
+
+TEST_F(KtimerTest, SameSlotLaterTurn) {
+    int ids[] = {1, 2};
+    struct ktimer soon, later;
+
+    ktimer_init(&soon, record, &ids[0]);
+    ktimer_init(&later, record, &ids[1]);
+    ktimer_add(&soon, 101);
+    ktimer_add(&later, 101 + KTIMER_WHEEL_SIZE);
+
+    ktimer_run(101);
+    EXPECT_EQ(std::vector<int>({1}), fired);
+    EXPECT_TRUE(ktimer_pending(&later));
+    ktimer_run(101 + KTIMER_WHEEL_SIZE);
+    EXPECT_EQ(std::vector<int>({1, 2}), fired);
+}
+
+TEST_F(KtimerTest, Cancel) {
+    int id = 1;
+    struct ktimer t;
+
+    ktimer_init(&t, record, &id);
+    EXPECT_FALSE(ktimer_cancel(&t));
+    ktimer_add(&t, 103);
+    EXPECT_TRUE(ktimer_cancel(&t));
+    EXPECT_FALSE(ktimer_pending(&t));
+    ktimer_run(110);
+    EXPECT_TRUE(fired.empty());
+}
+
+TEST_F(KtimerTest, PastExpirationFiresNextTick) {
+    int id = 1;
+    struct ktimer t;
+
+    ktimer_init(&t, record, &id);
+    ktimer_add(&t, 50);
+    ktimer_run(101);
+    EXPECT_EQ(std::vector<int>({1}), fired);
+}
+
+TEST_F(KtimerTest, ReArm) {
+    int id = 1;
+    struct ktimer t;
+
+    ktimer_init(&t, record, &id);
+    ktimer_add(&t, 102);
+    // Moving a pending timer keeps a single instance.
+    ktimer_add(&t, 104);
+    ktimer_run(103);
+    EXPECT_TRUE(fired.empty());
+    ktimer_run(104);
+    EXPECT_EQ(std::vector<int>({1}), fired);
+}
+
+TEST_F(KtimerTest, CounterWrap) {
+    int id = 1;
+    struct ktimer t;
+
+    ktimer_initialize(0xfffffffe);
+    ktimer_init(&t, record, &id);
+    ktimer_add(&t, 2);
+    ktimer_run(1);
+    EXPECT_TRUE(fired.empty());
+    ktimer_run(2);
+    EXPECT_EQ(std::vector<int>({1}), fired);
+}
+
+TEST_F(KtimerTest, NextExpiry) {
+    int id = 1;
+    uint32_t expires;
+    struct ktimer a, b;
+
+    EXPECT_FALSE(ktimer_next_expiry(&expires));
+
+    ktimer_init(&a, record, &id);
+    ktimer_init(&b, record, &id);
+    ktimer_add(&a, 100 + 3 * KTIMER_WHEEL_SIZE);
+    ktimer_add(&b, 140);
+    ASSERT_TRUE(ktimer_next_expiry(&expires));
+    EXPECT_EQ(140u, expires);
+
+    ktimer_cancel(&b);
+    ASSERT_TRUE(ktimer_next_expiry(&expires));
+    EXPECT_EQ(100u + 3 * KTIMER_WHEEL_SIZE, expires);
+    ktimer_cancel(&a);
+}
+
+static struct ktimer periodic;
+static int periodic_count;
+
+static void rearm(void *arg) {
+    (void)arg;
+    periodic_count++;
+    ktimer_add(&periodic, ktimer_now() + 2);
+}
+
+TEST_F(KtimerTest, ReArmFromCallback) {
+    periodic_count = 0;
+    ktimer_init(&periodic, rearm, NULL);
+    ktimer_add(&periodic, 102);
+    ktimer_run(110);
+    EXPECT_EQ(5, periodic_count);
+    ktimer_cancel(&periodic);
+}
+
+static std::vector<uint32_t> notified;
+
+static void notify(uint32_t expires) { notified.push_back(expires); }
+
+TEST_F(KtimerTest, NotifyOnAdd) {
+    struct ktimer t;
+
+    notified.clear();
+    ktimer_init(&t, record, NULL);
+    ktimer_set_notify(notify);
+    ktimer_add(&t, 120);
+    ktimer_add(&t, 50);
+    EXPECT_EQ(std::vector<uint32_t>({120, 101}), notified);
+    ktimer_cancel(&t);
+
+    // The notification function is reset with the wheel.
+    ktimer_initialize(100);
+    ktimer_add(&t, 130);
+    EXPECT_EQ(2u, notified.size());
+    ktimer_cancel(&t);
+}
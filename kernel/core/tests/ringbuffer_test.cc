@@ -91,4 +91,127 @@ TEST_F(RingBufferTest, WriteArrayWithOverflow) {
     EXPECT_EQ(0, strncmp("fghijklmnopqrst", result, rb_size()));
     EXPECT_EQ(1, ring_buffer_is_empty(&rb));
     EXPECT_EQ(0, ring_buffer_num_items(&rb));
-}
\ No newline at end of file
+}
+TEST_F(RingBufferTest, ArrayWrapAround) {
+    char result[16];
+
+    // Move the indexes close to the end of the buffer.
+    for (int i = 0; i < 12; i++) {
+        ring_buffer_queue(&rb, 'x');
+    }
+    EXPECT_EQ(12, ring_buffer_dequeue_arr(&rb, result, sizeof(result)));
+
+    // The array is split between the end and the start of the buffer.
+    const char *input = "abcdefghij";
+    ring_buffer_queue_arr(&rb, input, strlen(input));
+    EXPECT_EQ(strlen(input), ring_buffer_num_items(&rb));
+    EXPECT_EQ(0, strncmp("efghij", buf, 6));
+
+    // Read it back in two steps, the first one stops before the wrap.
+    EXPECT_EQ(3, ring_buffer_dequeue_arr(&rb, result, 3));
+    EXPECT_EQ(0, strncmp("abc", result, 3));
+    EXPECT_EQ(7, ring_buffer_dequeue_arr(&rb, result, sizeof(result)));
+    EXPECT_EQ(0, strncmp("defghij", result, 7));
+    EXPECT_EQ(1, ring_buffer_is_empty(&rb));
+}
+
+TEST_F(RingBufferTest, ArrayOverflowWrapAround) {
+    char result[16];
+
+    for (int i = 0; i < 10; i++) {
+        ring_buffer_queue(&rb, 'x');
+    }
+    EXPECT_EQ(10, ring_buffer_dequeue_arr(&rb, result, 10));
+    ring_buffer_queue_arr(&rb, "0123", 4);
+
+    // The oldest bytes are overwritten, across the end of the buffer.
+    const char *input = "abcdefghijklmn";
+    ring_buffer_queue_arr(&rb, input, strlen(input));
+    EXPECT_EQ(1, ring_buffer_is_full(&rb));
+    EXPECT_EQ(rb_size(), ring_buffer_dequeue_arr(&rb, result, sizeof(result)));
+    EXPECT_EQ(0, strncmp("3abcdefghijklmn", result, rb_size()));
+}
+
+TEST_F(RingBufferTest, DequeueEmpty) {
+    char result[4];
+    EXPECT_EQ(0, ring_buffer_dequeue_arr(&rb, result, sizeof(result)));
+    EXPECT_EQ(0, ring_buffer_dequeue_arr(&rb, result, 0));
+}
+
+TEST_F(RingBufferTest, ContiguousRegions) {
+    const char *rd;
+    char *wr;
+
+    // The whole buffer but the last slot is writable on an empty buffer.
+    EXPECT_EQ(rb_size(), ring_buffer_reserve_contiguous(&rb, &wr));
+    EXPECT_EQ(buf, wr);
+    EXPECT_EQ(0, ring_buffer_peek_contiguous(&rb, &rd));
+
+    // Move the indexes to the middle of the buffer.
+    memcpy(wr, "0123456789ab", 12);
+    ring_buffer_commit_write(&rb, 12);
+    EXPECT_EQ(12, ring_buffer_peek_contiguous(&rb, &rd));
+    EXPECT_EQ(buf, rd);
+    EXPECT_EQ(0, strncmp("0123", rd, 4));
+    ring_buffer_commit_read(&rb, 4);
+    EXPECT_EQ(8, ring_buffer_num_items(&rb));
+
+    // Free space stops at the end of the buffer, then resumes at its start.
+    EXPECT_EQ(4, ring_buffer_reserve_contiguous(&rb, &wr));
+    EXPECT_EQ(buf + 12, wr);
+    memcpy(wr, "cdef", 4);
+    ring_buffer_commit_write(&rb, 4);
+    EXPECT_EQ(3, ring_buffer_reserve_contiguous(&rb, &wr));
+    EXPECT_EQ(buf, wr);
+    memcpy(wr, "ghi", 3);
+    ring_buffer_commit_write(&rb, 3);
+    EXPECT_EQ(1, ring_buffer_is_full(&rb));
+    EXPECT_EQ(0, ring_buffer_reserve_contiguous(&rb, &wr));
+
+    // Reads also stop at the end of the buffer.
+    EXPECT_EQ(12, ring_buffer_peek_contiguous(&rb, &rd));
+    EXPECT_EQ(buf + 4, rd);
+    EXPECT_EQ(0, strncmp("456789abcdef", rd, 12));
+    ring_buffer_commit_read(&rb, 12);
+    EXPECT_EQ(3, ring_buffer_peek_contiguous(&rb, &rd));
+    EXPECT_EQ(buf, rd);
+    EXPECT_EQ(0, strncmp("ghi", rd, 3));
+    ring_buffer_commit_read(&rb, 3);
+    EXPECT_EQ(1, ring_buffer_is_empty(&rb));
+}
+
+TEST_F(RingBufferTest, TryQueueDoesNotOverwrite) {
+    for (long unsigned i = 0; i < rb_size(); i++) {
+        EXPECT_EQ(1, ring_buffer_try_queue(&rb, 'a' + i));
+    }
+    EXPECT_EQ(1, ring_buffer_is_full(&rb));
+
+    // The buffer is full: the byte is rejected and the oldest one is kept.
+    EXPECT_EQ(0, ring_buffer_try_queue(&rb, 'z'));
+    char c = 0;
+    EXPECT_EQ(1, ring_buffer_peek(&rb, &c, 0));
+    EXPECT_EQ('a', c);
+    EXPECT_EQ(rb_size(), ring_buffer_num_items(&rb));
+}
+
+TEST_F(RingBufferTest, TryQueueArrayBackPressure) {
+    char result[16];
+
+    // Start close to the end of the buffer to wrap around.
+    ring_buffer_queue_arr(&rb, "0123456789ab", 12);
+    EXPECT_EQ(10, ring_buffer_dequeue_arr(&rb, result, 10));
+
+    // Only the bytes that fit are added, the caller gets the count.
+    const char *input = "abcdefghijklmnopqrst";
+    EXPECT_EQ(13, ring_buffer_try_queue_arr(&rb, input, strlen(input)));
+    EXPECT_EQ(1, ring_buffer_is_full(&rb));
+    EXPECT_EQ(0, ring_buffer_try_queue_arr(&rb, input, strlen(input)));
+
+    // Nothing was overwritten.
+    EXPECT_EQ(rb_size(), ring_buffer_dequeue_arr(&rb, result, sizeof(result)));
+    EXPECT_EQ(0, strncmp("ababcdefghijklm", result, rb_size()));
+
+    // Room made by the consumer can be used again.
+    EXPECT_EQ(4, ring_buffer_try_queue_arr(&rb, "nopq", 4));
+    EXPECT_EQ(4, ring_buffer_num_items(&rb));
+}
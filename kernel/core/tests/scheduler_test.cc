@@ -0,0 +1,378 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+#include "error.h"
+#include "list.h"
+#include "scheduler.h"
+#include "taskpool.h"
+#include "waitqueue.h"
+}
+
+// Context switches are stubbed: schedule() only changes the current task,
+// which is enough to check the scheduling order.
+class SchedulerTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        scheduler_initialize();
+        main = scheduler_current();
+        memset(tasks, 0, sizeof(tasks));
+    }
+
+    void TearDown() override {
+        for (auto &t : tasks) {
+            free(t.descriptors);
+        }
+        free(main->descriptors);
+        free(main);
+    }
+
+    // Queues tasks[index] with |prio|.
+    struct task *Queue(int index, int prio) {
+        EXPECT_LE(0, scheduler_queue_new(&tasks[index], prio));
+        return &tasks[index];
+    }
+
+    // Puts the current task to sleep, the next ready task runs.
+    void Sleep() { scheduler_sleep_on(&sleepers); }
+
+    struct task *main;
+    struct task tasks[4];
+    struct list_node sleepers = LIST_INITIAL_VALUE(sleepers);
+};
+
+TEST_F(SchedulerTest, HighestPriorityFirst) {
+    struct task *low = Queue(0, 3);
+    struct task *high = Queue(1, SCHED_PRIO_MAX);
+    struct task *mid = Queue(2, 5);
+
+    schedule();
+    EXPECT_EQ(high, scheduler_current());
+    EXPECT_EQ(RUNNING, high->state);
+    EXPECT_EQ(READY, main->state);
+
+    Sleep();
+    EXPECT_EQ(main, scheduler_current());
+    Sleep();
+    EXPECT_EQ(mid, scheduler_current());
+    Sleep();
+    EXPECT_EQ(low, scheduler_current());
+}
+
+TEST_F(SchedulerTest, SamePriorityRunsInTurn) {
+    struct task *a = Queue(0, SCHED_PRIO_DEFAULT);
+    struct task *b = Queue(1, SCHED_PRIO_DEFAULT);
+
+    schedule();
+    EXPECT_EQ(a, scheduler_current());
+    schedule();
+    EXPECT_EQ(b, scheduler_current());
+    schedule();
+    EXPECT_EQ(main, scheduler_current());
+    schedule();
+    EXPECT_EQ(a, scheduler_current());
+}
+
+TEST_F(SchedulerTest, LowerPriorityWaits) {
+    struct task *idle = Queue(0, SCHED_PRIO_IDLE);
+
+    schedule();
+    EXPECT_EQ(main, scheduler_current());
+    EXPECT_EQ(READY, idle->state);
+
+    // The idle task only runs when nothing else can.
+    Sleep();
+    EXPECT_EQ(idle, scheduler_current());
+    EXPECT_EQ(WAITING, main->state);
+}
+
+TEST_F(SchedulerTest, WakeUp) {
+    Queue(0, SCHED_PRIO_IDLE);
+    struct task *high = Queue(1, SCHED_PRIO_MAX);
+
+    schedule();
+    ASSERT_EQ(high, scheduler_current());
+    Sleep();
+    EXPECT_EQ(main, scheduler_current());
+
+    list_delete(&high->node);
+    scheduler_wake_up(high);
+    EXPECT_EQ(READY, high->state);
+    schedule();
+    EXPECT_EQ(high, scheduler_current());
+}
+
+static int idle_exits;
+
+static void count_idle_exit(void) { idle_exits++; }
+
+TEST_F(SchedulerTest, IdleExitOnSwitch) {
+    struct task *idle = Queue(0, SCHED_PRIO_IDLE);
+
+    idle_exits = 0;
+    scheduler_set_idle_exit(count_idle_exit);
+    Sleep();
+    ASSERT_EQ(idle, scheduler_current());
+    EXPECT_EQ(0, idle_exits);
+
+    // An interrupt wakes up the main process, preempting the idle task.
+    list_delete(&main->node);
+    scheduler_wake_up(main);
+    scheduler_preempt();
+    EXPECT_EQ(main, scheduler_current());
+    EXPECT_EQ(1, idle_exits);
+
+    // Switching to the idle task doesn't count.
+    Sleep();
+    EXPECT_EQ(1, idle_exits);
+    scheduler_set_idle_exit(NULL);
+}
+
+TEST_F(SchedulerTest, SliceExhausted) {
+    ASSERT_EQ(0, scheduler_set_slice(SCHED_PRIO_DEFAULT, 3));
+    struct task *a = Queue(0, SCHED_PRIO_DEFAULT);
+
+    // main started with the default slice.
+    for (int i = 0; i < SCHED_SLICE_DEFAULT - 1; i++) {
+        scheduler_tick();
+        scheduler_preempt();
+        EXPECT_EQ(main, scheduler_current());
+    }
+    scheduler_tick();
+    scheduler_preempt();
+    ASSERT_EQ(a, scheduler_current());
+    EXPECT_EQ(1u, scheduler_preemptions());
+
+    // a got the new slice.
+    for (int i = 0; i < 2; i++) {
+        scheduler_tick();
+        scheduler_preempt();
+        EXPECT_EQ(a, scheduler_current());
+    }
+    scheduler_tick();
+    scheduler_preempt();
+    EXPECT_EQ(main, scheduler_current());
+    EXPECT_EQ(2u, scheduler_preemptions());
+    EXPECT_EQ(1u, a->nivcsw);
+}
+
+TEST_F(SchedulerTest, SliceAloneRenewed) {
+    // Nothing else to run: main keeps the CPU with a new slice.
+    for (int i = 0; i < 3 * SCHED_SLICE_DEFAULT; i++) {
+        scheduler_tick();
+        scheduler_preempt();
+        EXPECT_EQ(main, scheduler_current());
+    }
+    EXPECT_EQ(SCHED_SLICE_DEFAULT, main->slice);
+    EXPECT_EQ(0u, scheduler_preemptions());
+}
+
+TEST_F(SchedulerTest, HigherPriorityPreempts) {
+    struct task *high = Queue(0, SCHED_PRIO_MAX);
+
+    schedule();
+    ASSERT_EQ(high, scheduler_current());
+    Sleep();
+    ASSERT_EQ(main, scheduler_current());
+
+    // Nothing to preempt for, whatever the slice left.
+    scheduler_preempt();
+    EXPECT_EQ(main, scheduler_current());
+
+    // The woken up process doesn't wait for the end of the slice, and main
+    // keeps what's left of its own.
+    int slice = main->slice;
+    list_delete(&high->node);
+    scheduler_wake_up(high);
+    scheduler_preempt();
+    EXPECT_EQ(high, scheduler_current());
+    EXPECT_EQ(slice, main->slice);
+    EXPECT_EQ(1u, scheduler_preemptions());
+}
+
+TEST_F(SchedulerTest, InvalidSlice) {
+    EXPECT_EQ(ERR_INVAL, scheduler_set_slice(SCHED_PRIO_DEFAULT, 0));
+    EXPECT_EQ(ERR_INVAL,
+              scheduler_set_slice(SCHED_PRIO_DEFAULT, SCHED_SLICE_MAX + 1));
+    EXPECT_EQ(ERR_INVAL, scheduler_set_slice(SCHED_PRIO_MAX + 1, 1));
+}
+
+static uint32_t fake_clock;
+
+static uint32_t read_fake_clock(void) { return fake_clock; }
+
+TEST_F(SchedulerTest, CpuTime) {
+    struct task *a = Queue(0, SCHED_PRIO_DEFAULT);
+
+    fake_clock = 0;
+    scheduler_set_clock(read_fake_clock, 1000);
+
+    // 10 counts outside syscalls, 5 inside, then preempted.
+    fake_clock = 10;
+    scheduler_syscall_enter();
+    fake_clock = 15;
+    scheduler_syscall_exit();
+    schedule();
+    ASSERT_EQ(a, scheduler_current());
+    EXPECT_EQ(10u, main->utime);
+    EXPECT_EQ(5u, main->stime);
+    EXPECT_EQ(1u, main->nivcsw);
+
+    // The next process sleeps from a syscall.
+    fake_clock = 20;
+    scheduler_syscall_enter();
+    fake_clock = 27;
+    Sleep();
+    EXPECT_EQ(main, scheduler_current());
+    EXPECT_EQ(5u, a->utime);
+    EXPECT_EQ(7u, a->stime);
+    EXPECT_EQ(1u, a->nvcsw);
+    EXPECT_EQ(0u, a->nivcsw);
+    scheduler_dump();
+
+    scheduler_set_clock(NULL, 0);
+}
+
+TEST_F(SchedulerTest, WaitRusage) {
+    struct task *child = (struct task *)calloc(1, sizeof(*child));
+    struct rusage usage;
+    int wstatus;
+
+    fake_clock = 0;
+    scheduler_set_clock(read_fake_clock, 1000);
+    pid_t pid = scheduler_queue_new(child, SCHED_PRIO_DEFAULT);
+    schedule();
+    ASSERT_EQ(child, scheduler_current());
+
+    // The child runs for 1.5s, 0.25s of it in syscalls, and exits.
+    fake_clock = 1250;
+    scheduler_syscall_enter();
+    fake_clock = 1500;
+    scheduler_exit(3);
+    ASSERT_EQ(main, scheduler_current());
+
+    EXPECT_EQ(pid, scheduler_wait(pid, &wstatus, 0, &usage));
+    EXPECT_EQ(3, WEXITSTATUS(wstatus));
+    EXPECT_EQ(1, usage.ru_utime.tv_sec);
+    EXPECT_EQ(250000, usage.ru_utime.tv_usec);
+    EXPECT_EQ(0, usage.ru_stime.tv_sec);
+    EXPECT_EQ(250000, usage.ru_stime.tv_usec);
+    EXPECT_EQ(1, usage.ru_nvcsw);
+    EXPECT_EQ(0, usage.ru_nivcsw);
+
+    scheduler_set_clock(NULL, 0);
+}
+
+TEST_F(SchedulerTest, WaitNoChild) {
+    struct task *child = (struct task *)calloc(1, sizeof(*child));
+
+    EXPECT_EQ(ERR_NO_ENTRY, scheduler_wait(-1, NULL, 0, NULL));
+    pid_t pid = scheduler_queue_new(child, SCHED_PRIO_DEFAULT);
+    EXPECT_EQ(ERR_NO_ENTRY, scheduler_wait(pid + 1, NULL, 0, NULL));
+
+    // The child is still running.
+    EXPECT_EQ(0, scheduler_wait(pid, NULL, WNOHANG, NULL));
+    schedule();
+    ASSERT_EQ(child, scheduler_current());
+    scheduler_exit(0);
+    EXPECT_EQ(pid, scheduler_wait(-1, NULL, WNOHANG, NULL));
+}
+
+TEST_F(SchedulerTest, ExitWakesUpParent) {
+    struct task *child = (struct task *)calloc(1, sizeof(*child));
+    pid_t pid = scheduler_queue_new(child, SCHED_PRIO_DEFAULT);
+
+    // The parent waits for its children, the child runs and exits.
+    wait_queue_sleep(&main->child_exit);
+    ASSERT_EQ(child, scheduler_current());
+    scheduler_exit(1);
+    EXPECT_EQ(main, scheduler_current());
+    EXPECT_TRUE(wait_queue_empty(&main->child_exit));
+    EXPECT_EQ(pid, scheduler_wait(pid, NULL, 0, NULL));
+}
+
+TEST_F(SchedulerTest, FindByPid) {
+    struct task *child = (struct task *)calloc(1, sizeof(*child));
+    pid_t pid = scheduler_queue_new(child, SCHED_PRIO_DEFAULT);
+
+    EXPECT_EQ(main, scheduler_find(main->pid));
+    EXPECT_EQ(child, scheduler_find(pid));
+    EXPECT_EQ(NULL, scheduler_find(pid + 1));
+
+    // Exited processes are found until they're waited for.
+    schedule();
+    ASSERT_EQ(child, scheduler_current());
+    scheduler_exit(0);
+    EXPECT_EQ(child, scheduler_find(pid));
+    EXPECT_EQ(pid, scheduler_wait(pid, NULL, 0, NULL));
+    EXPECT_EQ(NULL, scheduler_find(pid));
+}
+
+TEST_F(SchedulerTest, OrphansAdopted) {
+    struct task *child = (struct task *)calloc(1, sizeof(*child));
+    struct task *running = (struct task *)calloc(1, sizeof(*running));
+    struct task *exited = (struct task *)calloc(1, sizeof(*exited));
+    pid_t child_pid = scheduler_queue_new(child, SCHED_PRIO_DEFAULT);
+
+    // The child starts two processes, one exits, then the child exits.
+    Sleep();
+    ASSERT_EQ(child, scheduler_current());
+    pid_t running_pid = scheduler_queue_new(running, SCHED_PRIO_IDLE);
+    pid_t exited_pid = scheduler_queue_new(exited, SCHED_PRIO_MAX);
+    EXPECT_EQ(child_pid, running->parent);
+    schedule();
+    ASSERT_EQ(exited, scheduler_current());
+    scheduler_exit(4);
+    ASSERT_EQ(child, scheduler_current());
+    scheduler_exit(0);
+    EXPECT_EQ(main->pid, running->parent);
+    EXPECT_EQ(main->pid, exited->parent);
+
+    // main reaps the exited ones, and waits for the running one.
+    ASSERT_EQ(running, scheduler_current());
+    list_delete(&main->node);
+    scheduler_wake_up(main);
+    schedule();
+    ASSERT_EQ(main, scheduler_current());
+    int wstatus;
+    EXPECT_EQ(exited_pid, scheduler_wait(exited_pid, &wstatus, 0, NULL));
+    EXPECT_EQ(4, WEXITSTATUS(wstatus));
+    EXPECT_EQ(child_pid, scheduler_wait(-1, NULL, WNOHANG, NULL));
+    EXPECT_EQ(0, scheduler_wait(-1, NULL, WNOHANG, NULL));
+    EXPECT_EQ(0, scheduler_wait(running_pid, NULL, WNOHANG, NULL));
+
+    free(running->descriptors);
+    free(running);
+}
+
+TEST_F(SchedulerTest, StackUsage) {
+    struct task *a = &tasks[0];
+    size_t size = 256;
+
+    a->stack = stack_alloc(&size);
+    a->stack_size = size;
+    ASSERT_NE(nullptr, a->stack);
+    Queue(0, SCHED_PRIO_DEFAULT);
+
+    // The canary is checked at every switch.
+    schedule();
+    ASSERT_EQ(a, scheduler_current());
+    memset((uint8_t *)a->stack + size - 40, 0, 40);
+    schedule();
+    ASSERT_EQ(main, scheduler_current());
+    EXPECT_EQ(40u, stack_high_water(a->stack, a->stack_size));
+
+    fake_clock = 0;
+    scheduler_set_clock(read_fake_clock, 1000);
+    scheduler_dump();
+    scheduler_set_clock(NULL, 0);
+    stack_release(a->stack, a->stack_size);
+}
+
+TEST_F(SchedulerTest, InvalidPriority) {
+    EXPECT_EQ(ERR_INVAL, scheduler_queue_new(&tasks[0], SCHED_PRIO_MAX + 1));
+    EXPECT_EQ(ERR_INVAL, scheduler_queue_new(&tasks[0], SCHED_PRIO_IDLE - 1));
+}
@@ -0,0 +1,90 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+extern "C" {
+#include "softirq.h"
+}
+
+static std::vector<int> runs;
+
+static void record(void *arg) { runs.push_back(*(int *)arg); }
+
+class SoftirqTest : public ::testing::Test {
+   protected:
+    void SetUp() override { runs.clear(); }
+};
+
+TEST_F(SoftirqTest, RunsInOrder) {
+    int ids[] = {1, 2};
+    struct tasklet first, second;
+
+    tasklet_init(&first, record, &ids[0]);
+    tasklet_init(&second, record, &ids[1]);
+    tasklet_schedule(&first);
+    tasklet_schedule(&second);
+    EXPECT_TRUE(runs.empty());
+
+    softirq_run();
+    EXPECT_EQ(std::vector<int>({1, 2}), runs);
+    EXPECT_FALSE(softirq_active());
+
+    // Nothing is pending anymore.
+    softirq_run();
+    EXPECT_EQ(2u, runs.size());
+}
+
+TEST_F(SoftirqTest, PendingTaskletRunsOnce) {
+    int id = 1;
+    struct tasklet t = TASKLET_INITIAL_VALUE(record, &id);
+
+    tasklet_schedule(&t);
+    tasklet_schedule(&t);
+    softirq_run();
+    EXPECT_EQ(std::vector<int>({1}), runs);
+}
+
+static struct tasklet nested;
+static int nested_id = 2;
+
+// Behaves like an interrupt handler arriving while a tasklet runs.
+static void interrupt(void *arg) {
+    EXPECT_TRUE(softirq_active());
+    record(arg);
+    tasklet_schedule(&nested);
+    softirq_run();
+    // The nested tasklet is left to the outer call.
+    EXPECT_EQ(1u, runs.size());
+}
+
+TEST_F(SoftirqTest, NestedRun) {
+    int id = 1;
+    struct tasklet t;
+
+    tasklet_init(&t, interrupt, &id);
+    tasklet_init(&nested, record, &nested_id);
+    tasklet_schedule(&t);
+    softirq_run();
+    EXPECT_EQ(std::vector<int>({1, 2}), runs);
+    EXPECT_FALSE(softirq_active());
+}
+
+static struct tasklet again;
+static int again_count;
+
+static void reschedule(void *arg) {
+    (void)arg;
+    if (++again_count < 3) {
+        tasklet_schedule(&again);
+    }
+}
+
+TEST_F(SoftirqTest, RescheduledWhileRunning) {
+    again_count = 0;
+    tasklet_init(&again, reschedule, NULL);
+    tasklet_schedule(&again);
+    softirq_run();
+    EXPECT_EQ(3, again_count);
+}
@@ -0,0 +1,59 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+#include "error.h"
+#include "task.h"
+}
+
+class TaskTest : public ::testing::Test {
+   protected:
+    void SetUp() override { memset(&task, 0, sizeof(task)); }
+
+    void TearDown() override { free(task.descriptors); }
+
+    struct task task;
+};
+
+TEST_F(TaskTest, ConsoleDescriptors) {
+    ASSERT_EQ(0, task_init_desc(&task));
+
+    for (int fd = 0; fd < CONSOLE_FDS; fd++) {
+        const struct descriptor *desc = task_get_desc(&task, fd);
+        ASSERT_NE(nullptr, desc);
+        EXPECT_EQ(DESC_CONSOLE, desc->type);
+    }
+    EXPECT_EQ(nullptr, task_get_desc(&task, CONSOLE_FDS));
+}
+
+TEST_F(TaskTest, PutDescriptor) {
+    int dummy;
+
+    // The table is allocated on first use, with the console descriptors.
+    EXPECT_EQ(CONSOLE_FDS, task_put_desc(&task, DESC_FILE, &dummy));
+    const struct descriptor *desc = task_get_desc(&task, CONSOLE_FDS);
+    ASSERT_NE(nullptr, desc);
+    EXPECT_EQ(DESC_FILE, desc->type);
+    EXPECT_EQ((filehandle *)&dummy, desc->handle.file);
+    EXPECT_EQ(DESC_CONSOLE, task_get_desc(&task, 0)->type);
+
+    // Closed descriptors are reused.
+    task_reset_desc(&task, 1);
+    EXPECT_EQ(nullptr, task_get_desc(&task, 1));
+    EXPECT_EQ(1, task_put_desc(&task, DESC_DIR, &dummy));
+
+    // Fill the table.
+    for (int fd = CONSOLE_FDS + 1; fd < MAX_FD; fd++) {
+        EXPECT_EQ(fd, task_put_desc(&task, DESC_FILE, &dummy));
+    }
+    EXPECT_EQ(ERR_NO_MEM, task_put_desc(&task, DESC_FILE, &dummy));
+}
+
+TEST_F(TaskTest, InvalidDescriptor) {
+    ASSERT_EQ(0, task_init_desc(&task));
+    EXPECT_EQ(nullptr, task_get_desc(&task, -1));
+    EXPECT_EQ(nullptr, task_get_desc(&task, MAX_FD));
+}
@@ -0,0 +1,97 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+
+extern "C" {
+#include "taskpool.h"
+}
+
+TEST(TaskPoolTest, StackSizeClasses) {
+    size_t size = 1;
+    void *stack = stack_alloc(&size);
+    ASSERT_NE(nullptr, stack);
+    EXPECT_EQ(STACK_MIN_SIZE, size);
+    stack_release(stack, size);
+
+    size = STACK_MIN_SIZE + 1;
+    stack = stack_alloc(&size);
+    ASSERT_NE(nullptr, stack);
+    EXPECT_EQ(2 * STACK_MIN_SIZE, size);
+    stack_release(stack, size);
+
+    // Large stacks keep their size.
+    size = STACK_MAX_SIZE + 1;
+    stack = stack_alloc(&size);
+    ASSERT_NE(nullptr, stack);
+    EXPECT_EQ(STACK_MAX_SIZE + 1, size);
+    stack_release(stack, size);
+}
+
+TEST(TaskPoolTest, StackReused) {
+    size_t size = 512;
+    uint8_t *stack = (uint8_t *)stack_alloc(&size);
+    ASSERT_NE(nullptr, stack);
+    EXPECT_TRUE(stack_intact(stack));
+    EXPECT_EQ(0u, stack_high_water(stack, size));
+
+    // Use the top of the stack.
+    memset(stack + size - 100, 0, 100);
+    EXPECT_EQ(100u, stack_high_water(stack, size));
+    stack_release(stack, size);
+
+    // The same stack comes back, painted again.
+    size_t again = 512;
+    EXPECT_EQ(stack, stack_alloc(&again));
+    EXPECT_EQ(size, again);
+    EXPECT_TRUE(stack_intact(stack));
+    EXPECT_EQ(0u, stack_high_water(stack, size));
+    stack_release(stack, size);
+}
+
+TEST(TaskPoolTest, StackOverflow) {
+    size_t size = 256;
+    uint8_t *stack = (uint8_t *)stack_alloc(&size);
+    ASSERT_NE(nullptr, stack);
+
+    memset(stack, 0, size);
+    EXPECT_FALSE(stack_intact(stack));
+    EXPECT_EQ(size - sizeof(uint16_t), stack_high_water(stack, size));
+    stack_release(stack, size);
+
+    size_t again = 256;
+    EXPECT_EQ(stack, stack_alloc(&again));
+    EXPECT_TRUE(stack_intact(stack));
+    EXPECT_EQ(0u, stack_high_water(stack, size));
+    stack_release(stack, size);
+}
+
+TEST(TaskPoolTest, TaskReused) {
+    struct task *t = task_alloc();
+    ASSERT_NE(nullptr, t);
+    t->pid = 12;
+    task_release(t);
+
+    // The same structure comes back, cleared.
+    EXPECT_EQ(t, task_alloc());
+    EXPECT_EQ(0, t->pid);
+    task_release(t);
+}
+
+TEST(TaskPoolTest, Reserve) {
+    size_t size = 1024;
+
+    taskpool_reserve(size, 1);
+    void *stack = stack_alloc(&size);
+    ASSERT_NE(nullptr, stack);
+    EXPECT_EQ(1024u, size);
+    EXPECT_TRUE(stack_intact(stack));
+    EXPECT_EQ(0u, stack_high_water(stack, size));
+    stack_release(stack, size);
+
+    struct task *t = task_alloc();
+    ASSERT_NE(nullptr, t);
+    EXPECT_EQ(0, t->pid);
+    task_release(t);
+}
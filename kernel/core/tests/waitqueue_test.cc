@@ -0,0 +1,76 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+#include "scheduler.h"
+#include "waitqueue.h"
+}
+
+// Context switches are stubbed: sleeping only changes the current task.
+class WaitQueueTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        scheduler_initialize();
+        main = scheduler_current();
+        memset(tasks, 0, sizeof(tasks));
+        for (auto &t : tasks) {
+            ASSERT_LE(0, scheduler_queue_new(&t, SCHED_PRIO_DEFAULT));
+        }
+        wait_queue_init(&wq);
+    }
+
+    void TearDown() override {
+        for (auto &t : tasks) {
+            free(t.descriptors);
+        }
+        free(main->descriptors);
+        free(main);
+    }
+
+    struct task *main;
+    struct task tasks[2];
+    struct wait_queue wq;
+};
+
+TEST_F(WaitQueueTest, WakeOneInOrder) {
+    EXPECT_EQ(NULL, wait_queue_wake_one(&wq));
+
+    // main, then tasks[0] go to sleep.
+    wait_queue_sleep(&wq);
+    ASSERT_EQ(&tasks[0], scheduler_current());
+    wait_queue_sleep(&wq);
+    ASSERT_EQ(&tasks[1], scheduler_current());
+    EXPECT_EQ(WAITING, main->state);
+    EXPECT_EQ(WAITING, tasks[0].state);
+
+    EXPECT_EQ(main, wait_queue_wake_one(&wq));
+    EXPECT_EQ(READY, main->state);
+    EXPECT_EQ(&tasks[0], wait_queue_wake_one(&wq));
+    EXPECT_TRUE(wait_queue_empty(&wq));
+}
+
+TEST_F(WaitQueueTest, WakeAll) {
+    EXPECT_EQ(0, wait_queue_wake_all(&wq));
+
+    wait_queue_sleep(&wq);
+    wait_queue_sleep(&wq);
+    EXPECT_FALSE(wait_queue_empty(&wq));
+    EXPECT_EQ(2, wait_queue_wake_all(&wq));
+    EXPECT_TRUE(wait_queue_empty(&wq));
+    EXPECT_EQ(READY, main->state);
+    EXPECT_EQ(READY, tasks[0].state);
+}
+
+static bool is_set(void *arg) { return *(bool *)arg; }
+
+TEST_F(WaitQueueTest, WaitConditionMet) {
+    bool ready = true;
+
+    // The condition holds, nothing to wait for.
+    wait_queue_wait(&wq, is_set, &ready);
+    EXPECT_EQ(main, scheduler_current());
+    EXPECT_TRUE(wait_queue_empty(&wq));
+}
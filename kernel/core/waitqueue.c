@@ -0,0 +1,45 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+
+#include "waitqueue.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "list.h"
+#include "scheduler.h"
+#include "task.h"
+
+void wait_queue_init(struct wait_queue *wq) { list_initialize(&wq->sleepers); }
+
+bool wait_queue_empty(struct wait_queue *wq) {
+    return list_is_empty(&wq->sleepers);
+}
+
+void wait_queue_sleep(struct wait_queue *wq) {
+    scheduler_sleep_on(&wq->sleepers);
+}
+
+void wait_queue_wait(struct wait_queue *wq, bool (*cond)(void *arg),
+                     void *arg) {
+    while (!cond(arg)) {
+        wait_queue_sleep(wq);
+    }
+}
+
+struct task *wait_queue_wake_one(struct wait_queue *wq) {
+    struct task *t = list_remove_head_type(&wq->sleepers, struct task, node);
+
+    if (t) {
+        scheduler_wake_up(t);
+    }
+    return t;
+}
+
+int wait_queue_wake_all(struct wait_queue *wq) {
+    int count = 0;
+
+    while (wait_queue_wake_one(wq)) {
+        count++;
+    }
+    return count;
+}
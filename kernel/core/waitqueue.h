@@ -0,0 +1,52 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+//
+// Wait queues: processes sleep on a queue until the event they wait for
+// happens, the code producing the event wakes up the queue. Sleepers are woken
+// up in the order they went to sleep.
+//
+// Processes sleep with interrupts disabled, and the wake-ups happen from
+// syscalls or tasklets: a wake-up can't slip between the check of the
+// condition and the sleep.
+
+#ifndef _WAITQUEUE_H_
+#define _WAITQUEUE_H_
+
+#include <stdbool.h>
+
+#include "list.h"
+
+struct task;
+
+struct wait_queue {
+    // Sleeping processes, in the order they went to sleep.
+    struct list_node sleepers;
+};
+
+#define WAIT_QUEUE_INITIAL_VALUE(wq) \
+    { .sleepers = LIST_INITIAL_VALUE((wq).sleepers) }
+
+// wait_queue_init prepares <wq> with no sleepers.
+void wait_queue_init(struct wait_queue *wq);
+
+// wait_queue_empty tells if no process sleeps on <wq>.
+bool wait_queue_empty(struct wait_queue *wq);
+
+// wait_queue_sleep puts the current process to sleep on <wq> until it's woken
+// up.
+void wait_queue_sleep(struct wait_queue *wq);
+
+// wait_queue_wait puts the current process to sleep on <wq> until <cond>
+// returns true for <arg>. The condition is checked before sleeping and after
+// every wake-up.
+void wait_queue_wait(struct wait_queue *wq, bool (*cond)(void *arg),
+                     void *arg);
+
+// wait_queue_wake_one wakes up the first process sleeping on <wq>. Returns the
+// process woken up, NULL if none was sleeping.
+struct task *wait_queue_wake_one(struct wait_queue *wq);
+
+// wait_queue_wake_all wakes up all the processes sleeping on <wq>. Returns the
+// number of processes woken up.
+int wait_queue_wake_all(struct wait_queue *wq);
+
+#endif  // _WAITQUEUE_H_
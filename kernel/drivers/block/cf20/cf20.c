@@ -16,11 +16,13 @@
 #include "interrupts.h"
 #include "list.h"
 #include "scheduler.h"
+#include "softirq.h"
+#include "waitqueue.h"
 
 // Driver private data.
 struct cf20_private *pdev;
 
-// List of all the I/O requests waiting to be satisfied.
+// List of all the bio requests waiting to be satisfied.
 struct list_node requests = LIST_INITIAL_VALUE(requests);
 
 // List of the bio request possible states.
@@ -38,6 +40,10 @@ typedef enum {
 #define BIO_DONE(s) ((s) == DONE)
 
 struct bio_request {
+    // Node in the requests list.
+    struct list_node node;
+    // Process waiting for the request to be done.
+    struct wait_queue done;
     bio_state_t state;
     block_t block;
     size_t count;
@@ -46,19 +52,20 @@ struct bio_request {
 
 extern void cf20_int_handler(void);
 
-void cf20_handler(void) {
-    struct task *task;
+// cf20_bio_tasklet transfers the ready sector and starts the next request. The
+// card keeps the sector in its buffer until it's read, the transfer is done
+// with interrupts enabled.
+static void cf20_bio_tasklet(void *arg) {
     struct bio_request *io_req;
 
-    irq_ack(pdev->irq);
+    (void)arg;
 
     // No requests to handle, this is a spurious interruption.
     if (list_is_empty(&requests)) {
         return;
     }
 
-    task = list_peek_head_type(&requests, struct task, node);
-    io_req = (struct bio_request *)task->wait_state;
+    io_req = list_peek_head_type(&requests, struct bio_request, node);
 
     // The command was already sent to the device, just read the sector that's
     // ready.
@@ -79,16 +86,15 @@ void cf20_handler(void) {
     // I/O request is finished, unblock the task waiting for it and prepare the
     // next one.
     if (BIO_DONE(io_req->state)) {
-        list_delete(&task->node);
-        scheduler_wake_up(task);
+        list_delete(&io_req->node);
+        wait_queue_wake_one(&io_req->done);
 
-        // Prepare the next task.
+        // Prepare the next request.
         if (list_is_empty(&requests)) {
-            // No next task, nothing else to do.
+            // No next request, nothing else to do.
             return;
         }
-        task = list_peek_head_type(&requests, struct task, node);
-        io_req = (struct bio_request *)task->wait_state;
+        io_req = list_peek_head_type(&requests, struct bio_request, node);
     }
 
     if (BIO_SEND(io_req->state)) {
@@ -100,6 +106,25 @@ void cf20_handler(void) {
     }
 }
 
+// Tells if the bio request <arg> is done.
+static bool cf20_bio_done(void *arg) {
+    struct bio_request *io_req = arg;
+    return BIO_DONE(io_req->state);
+}
+
+// Deferred handling of the card interrupts.
+static struct tasklet bio_tasklet =
+    TASKLET_INITIAL_VALUE(cf20_bio_tasklet, NULL);
+
+void cf20_handler(void) {
+    irq_ack(pdev->irq);
+    tasklet_schedule(&bio_tasklet);
+    softirq_run();
+
+    // Run right away a process of a higher priority the deferred work woke up.
+    scheduler_preempt();
+}
+
 int cf20_read_block(const struct blkdev *dev, void *buf, block_t block,
                     size_t count) {
     struct cf20_private *pdev = (struct cf20_private *)dev->drv_data;
@@ -112,6 +137,7 @@ int cf20_read_block(const struct blkdev *dev, void *buf, block_t block,
     io_req->block = block;
     io_req->count = count;
     io_req->buf = buf;
+    wait_queue_init(&io_req->done);
 
     if (list_is_empty(&requests)) {
         // Send a read sector command to the card.
@@ -122,7 +148,8 @@ int cf20_read_block(const struct blkdev *dev, void *buf, block_t block,
     }
 
     // Block waiting for the answer.
-    scheduler_sleep_on(&requests, io_req);
+    list_add_tail(&requests, &io_req->node);
+    wait_queue_wait(&io_req->done, cf20_bio_done, io_req);
 
     int bytes_read = (count - io_req->count) * pdev->sector_sz;
     free(io_req);
@@ -141,6 +168,7 @@ int cf20_write_block(const struct blkdev *dev, const void *buf, block_t block,
     io_req->block = block;
     io_req->count = count;
     io_req->buf = (void *)buf;
+    wait_queue_init(&io_req->done);
 
     if (list_is_empty(&requests)) {
         // Send a read sector command to the card.
@@ -151,7 +179,8 @@ int cf20_write_block(const struct blkdev *dev, const void *buf, block_t block,
     }
 
     // Block waiting for the answer.
-    scheduler_sleep_on(&requests, io_req);
+    list_add_tail(&requests, &io_req->node);
+    wait_queue_wait(&io_req->done, cf20_bio_done, io_req);
 
     int bytes_written = (count - io_req->count) * pdev->sector_sz;
     free(io_req);
@@ -8,12 +8,76 @@
 
 #include "ringbuffer.h"
 
+// Flow control modes, see uart_set_flow_control().
+#define UART_FLOW_NONE 0
+// Hardware flow control: RTS pauses the sender, CTS pauses the transmission.
+#define UART_FLOW_RTSCTS (1 << 0)
+// Software flow control with XON/XOFF chars.
+#define UART_FLOW_XONXOFF (1 << 1)
+
+// Number of bytes left in the TX ring when the driver calls uart_tx_notify().
+#define UART_TX_LOW_WATER(ring) (RING_BUFFER_MASK(ring) / 2)
+
+// Line errors and lost bytes counters.
+struct uart_stats {
+    // Bytes lost because the UART FIFO was full.
+    unsigned long overruns;
+    // Bytes received with a parity error.
+    unsigned long parity;
+    // Bytes received without a valid stop bit.
+    unsigned long framing;
+    // Break conditions detected on the line.
+    unsigned long breaks;
+    // Bytes dropped because the RX ring was full.
+    unsigned long dropped;
+};
+
 // uart_initialize prepares the UART for sending and receiving using buffers
-// and interruptions.
+// and interruptions. Falls back to 38400 bauds if <baud_rate> is not supported.
 void uart_initialize(ring_buffer_t *rx_ring, ring_buffer_t *tx_ring,
-                     uint16_t baud_rate);
+                     uint32_t baud_rate);
 
-// pc16550_start_xmit notifies the UART driver there's data in the tx queue.
+// uart_set_baud_rate changes the line rate to <baud_rate> once the char being
+// sent is complete. Returns 0 on success, ERR_INVAL if the UART clock can't
+// produce the rate.
+int uart_set_baud_rate(uint32_t baud_rate);
+
+// uart_set_rx_trigger sets the number of bytes in the RX FIFO that raises an
+// interrupt to <level>. Lower levels reduce the latency, higher levels the
+// interrupt load. Returns 0 on success, ERR_INVAL or ERR_NOT_SUPP if the level
+// is not supported.
+int uart_set_rx_trigger(int level);
+
+// uart_start_xmit notifies the UART driver there's data in the tx queue. When
+// the transmitter is idle, the first bytes are sent right away. It must be
+// called with interrupts disabled.
 void uart_start_xmit(void);
 
+// uart_flush sends the bytes left in the TX ring by polling the transmitter,
+// without interrupts, e.g. for the last message before the system halts. Flow
+// control is ignored. It must be called with interrupts disabled.
+void uart_flush(void);
+
+// uart_rx_consumed notifies the UART driver that bytes were removed from the
+// RX ring, so that a paused sender can resume. It must be called with
+// interrupts disabled.
+void uart_rx_consumed(void);
+
+// uart_set_flow_control selects the flow control <modes>, a combination of
+// UART_FLOW_* flags. When enabled, the sender is paused when the RX ring is
+// almost full. Returns 0 on success, ERR_NOT_SUPP or ERR_INVAL if the modes are
+// not supported.
+int uart_set_flow_control(int modes);
+
+// uart_get_stats copies the line errors and lost bytes counters to <stats>.
+void uart_get_stats(struct uart_stats *stats);
+
+// uart_rx_notify is called by the UART driver, from a tasklet, once received
+// bytes are queued in the RX ring. It is provided by the console.
+void uart_rx_notify(void);
+
+// uart_tx_notify is called by the UART driver, from a tasklet, once the TX ring
+// drained down to UART_TX_LOW_WATER. It is provided by the console.
+void uart_tx_notify(void);
+
 #endif  // _P8251_H_
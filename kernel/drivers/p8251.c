@@ -7,8 +7,11 @@
 #include "board.h"
 #include "cpu.h"
 #include "devices.h"
+#include "error.h"
 #include "interrupts.h"
 #include "ringbuffer.h"
+#include "scheduler.h"
+#include "softirq.h"
 #include "timer.h"
 #include "uart.h"
 
@@ -40,6 +43,7 @@
 #define CMD_TX_ENABLE 1
 #define CMD_RX_DISABLE 0
 #define CMD_RX_ENABLE (1 << 2)
+#define CMD_ERROR_RESET (1 << 4)
 #define CMD_FORCE_RTS (1 << 5)
 #define CMD_RESET (1 << 6)
 
@@ -64,6 +68,26 @@ static ring_buffer_t *rx_ring;
 static ring_buffer_t *tx_ring;
 // Current commands in the UART.
 static uint8_t cmd;
+// Line errors and lost bytes counters.
+static struct uart_stats stats;
+// PIT counter clocking the UART.
+static struct timer *timer2;
+
+static void p8251a_rx_tasklet(void *arg);
+// Deferred notification of the received bytes.
+static struct tasklet rx_tasklet =
+    TASKLET_INITIAL_VALUE(p8251a_rx_tasklet, NULL);
+static void p8251a_tx_tasklet(void *arg);
+// Deferred notification of the room made in the TX ring.
+static struct tasklet tx_tasklet =
+    TASKLET_INITIAL_VALUE(p8251a_tx_tasklet, NULL);
+
+// p8251a_valid_rate tells if the PIT can clock the UART at <baud_rate>: the
+// UART runs at the baud rate (MODE_ASYNC_1).
+static int p8251a_valid_rate(uint32_t baud_rate) {
+    return baud_rate && baud_rate <= timer2->freq &&
+           timer2->freq / baud_rate <= 0xffff;
+}
 
 static inline void p8251a_cmd(uint8_t command) {
     cmd = command;
@@ -71,12 +95,15 @@ static inline void p8251a_cmd(uint8_t command) {
 }
 
 void uart_initialize(ring_buffer_t *rxq, ring_buffer_t *txq,
-                     uint16_t baud_rate) {
+                     uint32_t baud_rate) {
     rx_ring = rxq;
     tx_ring = txq;
     // Configure the PIT to provide the frequency matching the desired baud
     // rate.
-    struct timer *timer2 = timer_get("timer2");
+    timer2 = timer_get("timer2");
+    if (!p8251a_valid_rate(baud_rate)) {
+        baud_rate = 38400;
+    }
     timer_set_freq(timer2, baud_rate);
     // Obtain the UART device.
     uart = board_get_io_dev(IO_DEV_UART);
@@ -99,7 +126,17 @@ void uart_initialize(ring_buffer_t *rxq, ring_buffer_t *txq,
     p8251a_cmd(CMD_RX_ENABLE | CMD_FORCE_RTS);
 
     // Print only after the UART is correctly initialized.
-    printf("UART: baudrate: %u, using IRQ %d\n", baud_rate, uart->irq);
+    printf("UART: baudrate: %lu, using IRQ %d\n", baud_rate, uart->irq);
+}
+
+static void p8251a_rx_tasklet(void *arg) {
+    (void)arg;
+    uart_rx_notify();
+}
+
+static void p8251a_tx_tasklet(void *arg) {
+    (void)arg;
+    uart_tx_notify();
 }
 
 void uart_handler(void) {
@@ -111,16 +148,38 @@ void uart_handler(void) {
     // Get the status of the UART controller.
     status = inb(P8251A_CMD(uart));
 
+    if (status &
+        (STATUS_PARITY_ERROR | STATUS_OVERRUN_ERROR | STATUS_FRAMING_ERROR)) {
+        if (status & STATUS_PARITY_ERROR) {
+            stats.parity++;
+        }
+        if (status & STATUS_OVERRUN_ERROR) {
+            stats.overruns++;
+        }
+        if (status & STATUS_FRAMING_ERROR) {
+            stats.framing++;
+        }
+        // Error flags stay set until explicitly cleared.
+        outb(P8251A_CMD(uart), cmd | CMD_ERROR_RESET);
+    }
+
     if (status & STATUS_RXRDY) {
         byte = inb(P8251A_DATA(uart));
         // Queue the byte into the reception buffer if there's any space left,
         // or drop it.
-        ring_buffer_queue(rx_ring, byte);
+        if (!ring_buffer_try_queue(rx_ring, byte)) {
+            stats.dropped++;
+        }
+        tasklet_schedule(&rx_tasklet);
     }
 
     if (status & STATUS_TXRDY) {
         if (ring_buffer_dequeue(tx_ring, (char *)&byte)) {
             outb(P8251A_DATA(uart), byte);
+            // Let the writers know once the ring reaches the low water mark.
+            if (ring_buffer_num_items(tx_ring) == UART_TX_LOW_WATER(tx_ring)) {
+                tasklet_schedule(&tx_tasklet);
+            }
         } else {
             // No more data to send, disable TX.
             cmd = CMD_RX_ENABLE;
@@ -132,6 +191,46 @@ void uart_handler(void) {
 
     // Acknoledge the interrupt controller.
     irq_ack(uart->irq);
+
+    softirq_run();
+
+    // Run right away a process of a higher priority the deferred work woke up.
+    scheduler_preempt();
 }
 
 void uart_start_xmit(void) { p8251a_cmd(cmd | CMD_TX_ENABLE); }
+
+void uart_flush(void) {
+    uint8_t byte;
+
+    p8251a_cmd(cmd | CMD_TX_ENABLE);
+    while (ring_buffer_dequeue(tx_ring, (char *)&byte)) {
+        while (!(inb(P8251A_CMD(uart)) & STATUS_TXRDY)) {
+        }
+        outb(P8251A_DATA(uart), byte);
+    }
+}
+
+// RTS is already lowered while each byte is handled, there's no room for
+// another flow control.
+void uart_rx_consumed(void) {}
+
+int uart_set_flow_control(int modes) {
+    return modes == UART_FLOW_NONE ? 0 : ERR_NOT_SUPP;
+}
+
+void uart_get_stats(struct uart_stats *st) { *st = stats; }
+
+int uart_set_baud_rate(uint32_t baud_rate) {
+    if (!p8251a_valid_rate(baud_rate)) {
+        return ERR_INVAL;
+    }
+    // Let the char being shifted out complete at the previous rate.
+    while (!(inb(P8251A_CMD(uart)) & STATUS_TXEMPTY)) {
+    }
+    timer_set_freq(timer2, baud_rate);
+    return 0;
+}
+
+// The 8251A has no FIFO: an interrupt is raised for every byte.
+int uart_set_rx_trigger(int level) { return level == 1 ? 0 : ERR_NOT_SUPP; }
@@ -7,12 +7,14 @@
 #include "board.h"
 #include "cpu.h"
 #include "devices.h"
+#include "error.h"
 #include "include/uart.h"
 #include "interrupts.h"
 #include "ringbuffer.h"
+#include "scheduler.h"
+#include "softirq.h"
 
 #define PC16550_TX_FIFO_SZ 16
-#define PC16550_RX_FIFO_TRIG 14
 
 #define PC16550_BUFR(dev) (dev->port)
 #define PC16550_IER(dev) (dev->port + 1)
@@ -82,7 +84,20 @@ typedef enum intr {
 #define MSR_CTS (1 << 4)
 #define MSR_DSR (1 << 5)
 #define MSR_RI (1 << 6)
-#define MSR_DCD (1 << 6)
+#define MSR_DCD (1 << 7)
+
+// Software flow control characters.
+#define XON 0x11
+#define XOFF 0x13
+
+// Number of bytes in the RX ring above which the sender is asked to pause, and
+// below which it is asked to resume.
+#define RX_HIGH_WATER(ring) (RING_BUFFER_MASK(ring) - RING_BUFFER_MASK(ring) / 4)
+#define RX_LOW_WATER(ring) (RING_BUFFER_MASK(ring) / 4)
+
+// Reasons for the transmission to be paused by the peer.
+#define TX_STOP_CTS 1
+#define TX_STOP_XOFF (1 << 1)
 
 // Assembly interrupt handler for the UART.
 extern void uart_int_handler(void);
@@ -93,8 +108,51 @@ static struct io_device *uart;
 static ring_buffer_t *rx_ring;
 // TX ring buffer instance.
 static ring_buffer_t *tx_ring;
+// Flow control modes in use.
+static int flow;
+// Set when the sender was asked to pause.
+static int rx_throttled;
+// Reasons for the transmission to be paused, 0 if it's not.
+static uint8_t tx_stop;
+// Flow control char to send before the TX ring data, 0 if there's none.
+static char tx_xchar;
+// Line errors and lost bytes counters.
+static struct uart_stats stats;
+// Copy of the interrupt enable register, saves reading it back.
+static uint8_t ier;
+
+static void pc16550_rx_tasklet(void *arg);
+// Deferred notification of the received bytes.
+static struct tasklet rx_tasklet =
+    TASKLET_INITIAL_VALUE(pc16550_rx_tasklet, NULL);
+static void pc16550_tx_tasklet(void *arg);
+// Deferred notification of the room made in the TX ring.
+static struct tasklet tx_tasklet =
+    TASKLET_INITIAL_VALUE(pc16550_tx_tasklet, NULL);
+
+// pc16550_divisor returns the clock divisor for <baud_rate>, or 0 if the UART
+// clock can't produce it within 3%, the tolerance of an 8N1 frame.
+static uint16_t pc16550_divisor(uint32_t baud_rate) {
+    // The UART samples the line at 16 times the baud rate.
+    uint32_t clk = uart->u.uart.freq >> 4;
+    uint32_t div, actual, diff;
+
+    if (!baud_rate || baud_rate > clk) {
+        return 0;
+    }
+    div = (clk + baud_rate / 2) / baud_rate;
+    if (div > 0xffff) {
+        return 0;
+    }
+    actual = clk / div;
+    diff = actual > baud_rate ? actual - baud_rate : baud_rate - actual;
+    if (diff * 32 > baud_rate) {
+        return 0;
+    }
+    return (uint16_t)div;
+}
 
-static void pc16550_set_baud_rate(uint16_t baud_rate) {
+static void pc16550_set_divisor(uint16_t div) {
     uint8_t lcr;
 
     // Set the Divisor Latch Bit to be able to set the divisor.
@@ -102,8 +160,6 @@ static void pc16550_set_baud_rate(uint16_t baud_rate) {
     lcr |= LCR_DLAB;
     outb(PC16550_LINE_CTRL(uart), lcr);
 
-    // The divisor is computed as follow: UART_FREQ / (16 * baud_rate).
-    uint32_t div = (uart->u.uart.freq >> 4) / (uint32_t)baud_rate;
     // Divisor LSB
     outb(PC16550_DIV_LSB(uart), div & 0xff);
     // Divisor MSB
@@ -113,31 +169,46 @@ static void pc16550_set_baud_rate(uint16_t baud_rate) {
     outb(PC16550_LINE_CTRL(uart), lcr);
 }
 
-static inline void pc16550_enable_tx_int(void) {}
+static inline void pc16550_enable_tx_int(void) {
+    ier |= IER_TX_RDY;
+    outb(PC16550_IER(uart), ier);
+}
 
 static inline void pc16550_disable_tx_int(void) {
-    uint8_t ier = inb(PC16550_IER(uart));
     ier &= ~IER_TX_RDY;
     outb(PC16550_IER(uart), ier);
 }
 
 void uart_initialize(ring_buffer_t *rxq, ring_buffer_t *txq,
-                     uint16_t baud_rate) {
+                     uint32_t baud_rate) {
+    uint16_t div;
+
     rx_ring = rxq;
     tx_ring = txq;
     // Obtain the I/O device.
     uart = board_get_io_dev(IO_DEV_UART);
-    // Enable FIFO mode with a trigger at 8 bytes in the queue.
+    // Enable FIFO mode with a trigger at 14 bytes in the queue.
     outb(PC16550_FCR(uart),
          FCR_RX_TX_ENABLE | FCR_RX_CLEAR | FCR_TX_CLEAR | FCR_TRIGGER_14B);
     // Use 8 bits per word, no parity, one stop bit.
     outb(PC16550_LINE_CTRL(uart), LCR_8BITS);
     // Enable interrupts.
-    outb(PC16550_IER(uart), IER_RX_RDY | IER_RX_LINE_STATUS);
-    // Set clock dividor register.
-    pc16550_set_baud_rate(baud_rate);
+    ier = IER_RX_RDY | IER_RX_LINE_STATUS;
+    outb(PC16550_IER(uart), ier);
+    // Set clock dividor register, falling back to 38400 bauds when the rate
+    // can't be produced.
+    div = pc16550_divisor(baud_rate);
+    if (!div) {
+        baud_rate = 38400;
+        div = pc16550_divisor(baud_rate);
+    }
+    pc16550_set_divisor(div);
     // Ensure RTS is low.
     outb(PC16550_MCR(uart), MCR_RTS);
+    flow = UART_FLOW_NONE;
+    rx_throttled = 0;
+    tx_stop = 0;
+    tx_xchar = 0;
 
     // Hook up the interrupt handler.
     interrupts_handle(interrupts_from_irq(uart->irq), KERNEL_CS,
@@ -145,60 +216,166 @@ void uart_initialize(ring_buffer_t *rxq, ring_buffer_t *txq,
     // Unmask the UART interrupt.
     irq_enable(uart->irq);
 
-    printf("UART: baudrate: %u, using IRQ %d\n", baud_rate, uart->irq);
+    printf("UART: baudrate: %lu, using IRQ %d\n", baud_rate, uart->irq);
+}
+
+// pc16550_set_rts drives the RTS line, telling the sender if it can transmit.
+static void pc16550_set_rts(int ready) {
+    uint8_t mcr = inb(PC16550_MCR(uart));
+    if (ready) {
+        mcr |= MCR_RTS;
+    } else {
+        mcr &= ~MCR_RTS;
+    }
+    outb(PC16550_MCR(uart), mcr);
+}
+
+// pc16550_send_xchar sends the flow control char <c> ahead of the TX ring.
+static void pc16550_send_xchar(char c) {
+    tx_xchar = c;
+    uart_start_xmit();
+}
+
+// pc16550_line_errors counts the errors reported by the line status <lsr>.
+static void pc16550_line_errors(uint8_t lsr) {
+    if (lsr & LSR_OVERRUN_ERR) {
+        stats.overruns++;
+    }
+    if (lsr & LSR_PARITY_ERR) {
+        stats.parity++;
+    }
+    if (lsr & LSR_FRAME_ERR) {
+        stats.framing++;
+    }
+    if (lsr & LSR_BREAK_INT) {
+        stats.breaks++;
+    }
+}
+
+// pc16550_rx_byte handles a received byte: flow control chars pause or resume
+// the transmission, other bytes are queued in the RX ring.
+static void pc16550_rx_byte(char data) {
+    if (flow & UART_FLOW_XONXOFF) {
+        if (data == XOFF) {
+            tx_stop |= TX_STOP_XOFF;
+            return;
+        }
+        if (data == XON) {
+            tx_stop &= ~TX_STOP_XOFF;
+            uart_start_xmit();
+            return;
+        }
+    }
+    if (!ring_buffer_try_queue(rx_ring, data)) {
+        stats.dropped++;
+    }
+}
+
+// pc16550_rx_throttle asks the sender to pause when the RX ring is almost
+// full.
+static void pc16550_rx_throttle(void) {
+    if (rx_throttled || !flow ||
+        ring_buffer_num_items(rx_ring) < RX_HIGH_WATER(rx_ring)) {
+        return;
+    }
+    rx_throttled = 1;
+    if (flow & UART_FLOW_RTSCTS) {
+        pc16550_set_rts(0);
+    }
+    if (flow & UART_FLOW_XONXOFF) {
+        pc16550_send_xchar(XOFF);
+    }
+}
+
+// pc16550_tx_pending tells if there are bytes allowed to be sent.
+static inline int pc16550_tx_pending(void) {
+    return tx_xchar || (!tx_stop && !ring_buffer_is_empty(tx_ring));
+}
+
+// pc16550_fill_fifo moves the pending bytes to the empty TX FIFO, the flow
+// control char first.
+static void pc16550_fill_fifo(void) {
+    int sent = 0;
+    char data;
+
+    if (tx_xchar) {
+        outb(PC16550_BUFR(uart), tx_xchar);
+        tx_xchar = 0;
+        sent++;
+    }
+    if (!tx_stop) {
+        // The FIFO is empty, we can put at most 16 bytes inside.
+        for (; sent < PC16550_TX_FIFO_SZ && ring_buffer_dequeue(tx_ring, &data);
+             sent++) {
+            outb(PC16550_BUFR(uart), data);
+        }
+    }
+}
+
+static void pc16550_rx_tasklet(void *arg) {
+    (void)arg;
+    uart_rx_notify();
+}
+
+static void pc16550_tx_tasklet(void *arg) {
+    (void)arg;
+    uart_tx_notify();
 }
 
 void uart_handler(void) {
     uint8_t isr, status;
-    char data;
+    size_t pending;
 
     isr = inb(PC16550_ISR(uart));
     while (!(isr & ISR_NO_INTERRUPT)) {
         switch (ISR_INT_ID(isr)) {
             case RX_DATA:
-                // The queue has reached the trigger so we exactly know how many
-                // bytes we can pull.
-                for (int i = 0; i < PC16550_RX_FIFO_TRIG; i++) {
-                    char data = (char)inb(PC16550_BUFR(uart));
-                    ring_buffer_queue(rx_ring, data);
-                }
-                break;
-
             case RX_FIFO_TIMEOUT:
-                // FIFO timeout implies we don't know how many bytes are
-                // available. Pull everything while checking the status
-                // register each time.
+                // The FIFO may hold more bytes than the trigger level once the
+                // interrupt is served, or less on timeout. Pull everything
+                // while checking the status register each time.
                 status = inb(PC16550_LSR(uart));
                 while (status & LSR_DATA_READY) {
-                    char data = (char)inb(PC16550_BUFR(uart));
-                    ring_buffer_queue(rx_ring, data);
+                    pc16550_line_errors(status);
+                    pc16550_rx_byte((char)inb(PC16550_BUFR(uart)));
                     status = inb(PC16550_LSR(uart));
                 }
+                pc16550_rx_throttle();
+                tasklet_schedule(&rx_tasklet);
                 break;
 
             case RX_LINE_STATUS:
-                // TODO: handle errors.
-                (void)inb(PC16550_LSR(uart));
+                pc16550_line_errors(inb(PC16550_LSR(uart)));
                 break;
 
             case TX_EMPTY:
-                // The FIFO is empty, we can put at most 16 bytes inside.
-                if (!ring_buffer_is_empty(tx_ring)) {
-                    for (int i = 0; i < PC16550_TX_FIFO_SZ &&
-                                    !ring_buffer_is_empty(tx_ring);
-                         i++) {
-                        ring_buffer_dequeue(tx_ring, &data);
-                        outb(PC16550_BUFR(uart), data);
-                    }
-                } else {
-                    // Disable TX_EMPTY interrupt since there's nothing to
-                    // transmit.
+                pending = ring_buffer_num_items(tx_ring);
+                pc16550_fill_fifo();
+                // Let the writers know once the ring crosses the low water
+                // mark.
+                if (pending > UART_TX_LOW_WATER(tx_ring) &&
+                    ring_buffer_num_items(tx_ring) <=
+                        UART_TX_LOW_WATER(tx_ring)) {
+                    tasklet_schedule(&tx_tasklet);
+                }
+                // Stop the TX_EMPTY interrupts as soon as the ring is drained,
+                // uart_start_xmit() restarts them when needed.
+                if (!pc16550_tx_pending()) {
                     pc16550_disable_tx_int();
                 }
                 break;
 
             case MODEM_STATUS:
-                (void)inb(PC16550_MSR(uart));
+                status = inb(PC16550_MSR(uart));
+                if (flow & UART_FLOW_RTSCTS) {
+                    // The peer drives CTS to pause or resume our transmission.
+                    if (status & MSR_CTS) {
+                        tx_stop &= ~TX_STOP_CTS;
+                        uart_start_xmit();
+                    } else {
+                        tx_stop |= TX_STOP_CTS;
+                    }
+                }
                 break;
         }
         isr = inb(PC16550_ISR(uart));
@@ -206,11 +383,121 @@ void uart_handler(void) {
 
     // Acknoledge the interrupt controller.
     irq_ack(uart->irq);
+
+    softirq_run();
+
+    // Run right away a process of a higher priority the deferred work woke up.
+    scheduler_preempt();
 }
 
 void uart_start_xmit(void) {
-    uint8_t ier = inb(PC16550_IER(uart));
-    // Enable the transmit interruption.
-    ier |= IER_TX_RDY;
+    // The interrupt handler is already draining the TX ring.
+    if (ier & IER_TX_RDY) {
+        return;
+    }
+    // The transmitter is idle: fill the FIFO right away rather than waiting for
+    // a TX_EMPTY interrupt.
+    if (inb(PC16550_LSR(uart)) & LSR_THRE) {
+        pc16550_fill_fifo();
+    }
+    // Let the interrupt handler send what didn't fit.
+    if (pc16550_tx_pending()) {
+        pc16550_enable_tx_int();
+    }
+}
+
+void uart_flush(void) {
+    char data;
+
+    while (ring_buffer_dequeue(tx_ring, &data)) {
+        while (!(inb(PC16550_LSR(uart)) & LSR_THRE)) {
+        }
+        outb(PC16550_BUFR(uart), data);
+    }
+}
+
+void uart_rx_consumed(void) {
+    if (!rx_throttled ||
+        ring_buffer_num_items(rx_ring) > RX_LOW_WATER(rx_ring)) {
+        return;
+    }
+    // Enough room was made in the RX ring, let the sender resume.
+    rx_throttled = 0;
+    if (flow & UART_FLOW_RTSCTS) {
+        pc16550_set_rts(1);
+    }
+    if (flow & UART_FLOW_XONXOFF) {
+        pc16550_send_xchar(XON);
+    }
+}
+
+int uart_set_flow_control(int modes) {
+    if (modes & ~(UART_FLOW_RTSCTS | UART_FLOW_XONXOFF)) {
+        return ERR_INVAL;
+    }
+
+    flow = modes;
+    if (flow & UART_FLOW_RTSCTS) {
+        // Follow CTS changes, starting from its current state.
+        ier |= IER_MODEM_STATUS;
+        if (inb(PC16550_MSR(uart)) & MSR_CTS) {
+            tx_stop &= ~TX_STOP_CTS;
+        } else {
+            tx_stop |= TX_STOP_CTS;
+        }
+    } else {
+        ier &= ~IER_MODEM_STATUS;
+        tx_stop &= ~TX_STOP_CTS;
+    }
     outb(PC16550_IER(uart), ier);
+    if (!(flow & UART_FLOW_XONXOFF)) {
+        tx_stop &= ~TX_STOP_XOFF;
+    }
+
+    // Without flow control, the sender is always allowed to transmit.
+    if (!flow && rx_throttled) {
+        rx_throttled = 0;
+        pc16550_set_rts(1);
+    }
+    uart_start_xmit();
+    return 0;
+}
+
+void uart_get_stats(struct uart_stats *st) { *st = stats; }
+
+int uart_set_baud_rate(uint32_t baud_rate) {
+    uint16_t div = pc16550_divisor(baud_rate);
+
+    if (!div) {
+        return ERR_INVAL;
+    }
+    // Let the char being shifted out complete at the previous rate.
+    while (!(inb(PC16550_LSR(uart)) & LSR_TEMT)) {
+    }
+    pc16550_set_divisor(div);
+    return 0;
+}
+
+int uart_set_rx_trigger(int level) {
+    uint8_t rx_trigger;
+
+    switch (level) {
+        case 1:
+            rx_trigger = FCR_TRIGGER_1B;
+            break;
+        case 4:
+            rx_trigger = FCR_TRIGGER_4B;
+            break;
+        case 8:
+            rx_trigger = FCR_TRIGGER_8B;
+            break;
+        case 14:
+            rx_trigger = FCR_TRIGGER_14B;
+            break;
+        default:
+            return ERR_INVAL;
+    }
+    // FIFOs are kept enabled, their content is preserved.
+    outb(PC16550_FCR(uart), FCR_RX_TX_ENABLE | rx_trigger);
+    return 0;
 }
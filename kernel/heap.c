@@ -15,10 +15,14 @@ void *heap_max;
 // Current heap address.
 void *heap;
 
+// Highest heap address reached.
+static void *heap_high;
+
 void heap_initialize(void *start, void *end) {
     heap_base = start;
     heap_max = end;
     heap = heap_base;
+    heap_high = heap_base;
 }
 
 void *heap_brk(void *addr) {
@@ -30,5 +34,14 @@ void *heap_brk(void *addr) {
         return (void *)-1;
     }
     heap = addr;
+    if (heap > heap_high) {
+        heap_high = heap;
+    }
     return heap;
 }
+
+void heap_get_stats(struct heap_stats *st) {
+    st->size = (char *)heap_max - (char *)heap_base;
+    st->brk = (char *)heap - (char *)heap_base;
+    st->max_brk = (char *)heap_high - (char *)heap_base;
+}
@@ -3,12 +3,26 @@
 #ifndef _HEAP_H_
 #define _HEAP_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
+// Kernel heap statistics, see heap_get_stats().
+struct heap_stats {
+    // Maximum size of the heap.
+    size_t size;
+    // Current size of the heap.
+    size_t brk;
+    // Highest size the heap reached.
+    size_t max_brk;
+};
+
 // heap_initialize prepares the heap for future allocations.
 void heap_initialize(void *start, void *end);
 
 // heap_brk
 void *heap_brk(void *addr);
 
+// heap_get_stats fills |st| with the kernel heap statistics.
+void heap_get_stats(struct heap_stats *st);
+
 #endif  // _HEAP_H_
@@ -17,6 +17,10 @@
 // Kernel C entry point.
 // cs is the code segment where the kernel runs provided by crt0.S.
 void kernel(void) {
+    // Kernel messages are written as soon as they're printed: interrupt
+    // handlers, tasklets and threads print concurrently, and a message must
+    // not wait in a buffer for its line to complete.
+    setvbuf(stdout, NULL, _IONBF, 0);
     // Declare the devices present on the board.
     board_initialize();
     // Initiliaze the heap to alloc future allocations.
@@ -29,6 +33,8 @@ void kernel(void) {
     mem_initialize();
     // Prepares the scheduler to manage thread and processes.
     scheduler_initialize();
+    // Report the fatal errors of the scheduler without interrupts.
+    scheduler_set_panic_write(console_write_polled);
     // Start minimal kernel threads.
     kthread_initialize();
 
@@ -52,6 +58,9 @@ void kernel(void) {
     // Probe devices and instantiate the drivers.
     driver_probes();
 
+    // Report the memory usage once the kernel is fully initialized.
+    mem_report();
+
     // Kernel initialization is done, start the init process.
     printf("Kernel booted!\n");
     init();
@@ -7,9 +7,21 @@
 #include <stdlib.h>
 
 #include "board.h"
+#include "clk.h"
 #include "cpu.h"
 #include "error.h"
 #include "scheduler.h"
+#include "taskpool.h"
+
+// Number of kernel threads that can start without going through the heap, and
+// the size of their stack. They can be set at build time, e.g. with
+// --copt=-DKTHREAD_RESERVE=4.
+#ifndef KTHREAD_RESERVE
+#define KTHREAD_RESERVE 2
+#endif
+#ifndef KTHREAD_RESERVE_STACK
+#define KTHREAD_RESERVE_STACK 512
+#endif
 
 // Helper to fill the initial stack.
 struct bootstrap_stack {
@@ -24,9 +36,17 @@ struct bootstrap_stack {
     int (*kthread_start)(void);
 };
 
-// Kernel idle task, does nothing except pause waiting for interrupts.
+// Kernel idle task, does nothing except pause waiting for interrupts. The clock
+// tick is stopped while it waits.
 int _kernel_idle() {
     while (1) {
+        cli();
+        // An interrupt may have made a task ready: restart the tick to run it.
+        clk_idle_exit();
+        schedule();
+        clk_idle_enter();
+        // sti takes effect after hlt starts: no interrupt can be missed.
+        sti();
         hlt();
     }
     // This function is never supposed to exit.
@@ -39,8 +59,11 @@ void _kthread_bootstrap(int (*fn)(void)) {
 }
 
 void kthread_initialize(void) {
+    // Keep processes and stacks ready for the next threads.
+    taskpool_reserve(KTHREAD_RESERVE_STACK, KTHREAD_RESERVE);
+
     // Start the background thread.
-    kthread_start(_kernel_idle, 510, -32767);
+    kthread_start(_kernel_idle, 510, SCHED_PRIO_IDLE);
 }
 
 int kthread_start(int (*fn)(void), size_t sz, int prio) {
@@ -53,15 +76,17 @@ int kthread_start(int (*fn)(void), size_t sz, int prio) {
         return ERR_INVAL;
     }
 
-    uint8_t *stack = malloc(sz);
+    // The stack may be larger than requested, the thread gets all of it.
+    uint8_t *stack = stack_alloc(&sz);
     if (!stack) {
         printf("kthread: failed to allocate the stack\n");
         return ERR_NO_MEM;
     }
 
-    new = calloc(1, sizeof(*new));
+    new = task_alloc();
     if (!new) {
         printf("kthread: failed to allocate task\n");
+        stack_release(stack, sz);
         return ERR_NO_MEM;
     }
 
@@ -75,9 +100,15 @@ int kthread_start(int (*fn)(void), size_t sz, int prio) {
 
     // Initialize the process structure.
     new->stack = stack;
+    new->stack_size = sz;
     new->ctx.ss = KERNEL_SS;
     new->ctx.sp = bst;
 
     // Add the task to the ready list for later scheduling.
-    return scheduler_queue_new(new, prio);
+    int pid = scheduler_queue_new(new, prio);
+    if (pid < 0) {
+        stack_release(stack, sz);
+        task_release(new);
+    }
+    return pid;
 }
@@ -2,12 +2,14 @@
 
 #include "mem.h"
 
+#include <malloc.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
 #include "devices.h"
 #include "fmem.h"
+#include "heap.h"
 #include "page.h"
 
 #define MEM_MAGIC0 0x55AA
@@ -51,4 +53,29 @@ void mem_initialize(void) {
         // Move one segment further.
         seg += 0x1000;
     }
-}
\ No newline at end of file
+}
+
+void mem_report(void) {
+    struct heap_stats hs;
+    struct page_stats ps;
+
+    // Kernel heap: brk usage, then the allocator working on top of it.
+    heap_get_stats(&hs);
+    printf("mem: heap: brk %u/%u bytes (max %u)\n", hs.brk, hs.size,
+           hs.max_brk);
+    malloc_print_stats();
+
+    // Far memory managed by the page allocator.
+    page_get_stats(&ps);
+    printf("mem: pages: %lu/%lu bytes in use (max %lu), largest free %lu\n",
+           ps.in_use, ps.total, ps.max_in_use, ps.largest_free);
+    printf("mem: pages: allocs: %lu, frees: %lu, free areas:", ps.allocs,
+           ps.frees);
+    for (size_t i = 0; i < MAX_ORDER; i++) {
+        if (ps.free_areas[i]) {
+            printf(" %u*%luK", ps.free_areas[i],
+                   1ul << (i + PAGE_SHIFT - 10));
+        }
+    }
+    printf("\n");
+}
@@ -7,4 +7,8 @@
 // available on the board.
 void mem_initialize(void);
 
+// mem_report prints the usage of the kernel heap and of the page allocator on
+// the console.
+void mem_report(void);
+
 #endif  // _MEM_H_
@@ -8,9 +8,7 @@
 
 #include "fmem.h"
 
-#define PAGE_SHIFT 10
 #define PAGE_MAGIC 0xDEAD5A5A
-#define MAX_ORDER 7
 
 struct fnode {
     struct fnode far *prev;
@@ -74,6 +72,17 @@ struct free_area {
 // Set of free areas.
 struct fnode free_areas[MAX_ORDER];
 
+// Page allocator statistics.
+static struct page_stats stats;
+
+static void page_stats_alloc(size_t order) {
+    stats.allocs++;
+    stats.in_use += 1ul << (order + PAGE_SHIFT);
+    if (stats.in_use > stats.max_in_use) {
+        stats.max_in_use = stats.in_use;
+    }
+}
+
 static void_fptr_t page_buddy(void_fptr_t addr, size_t order) {
     uint32_t ptr = (uint32_t)addr;
     uint32_t base = ptr & 0xffff0000;
@@ -84,12 +93,14 @@ static void page_push(void_fptr_t addr, size_t order) {
     struct free_area far *new = addr;
     new->magic = PAGE_MAGIC;
     flist_push(&free_areas[order], &new->node);
+    stats.free_areas[order]++;
 }
 
 static void page_queue(void_fptr_t addr, size_t order) {
     struct free_area far *new = addr;
     new->magic = PAGE_MAGIC;
     flist_queue(&free_areas[order], &new->node);
+    stats.free_areas[order]++;
 }
 
 static struct free_area far *page_pop(size_t order) {
@@ -97,6 +108,7 @@ static struct free_area far *page_pop(size_t order) {
         flist_pop_type(&free_areas[order], struct free_area, node);
     if (area) {
         area->magic = 0;
+        stats.free_areas[order]--;
     }
     return area;
 }
@@ -129,6 +141,7 @@ struct page *page_alloc(size_t order) {
     struct page *p = calloc(1, sizeof(*p));
     p->addr = zone;
     p->order = order;
+    page_stats_alloc(order);
     return p;
 }
 
@@ -148,6 +161,8 @@ void page_free(struct page *p) {
     addr = p->addr;
     order = p->order;
     free(p);
+    stats.frees++;
+    stats.in_use -= 1ul << (order + PAGE_SHIFT);
 
     buddy = page_buddy(addr, order);
     if (buddy->magic != PAGE_MAGIC) {
@@ -169,10 +184,22 @@ void page_add(void_fptr_t area, size_t order) {
         return;
     }
     page_queue(area, order);
+    stats.total += 1ul << (order + PAGE_SHIFT);
 }
 
 void page_initialize(void) {
     for (size_t i = 0; i < MAX_ORDER; i++) {
         flist_init(&free_areas[i]);
     }
-}
\ No newline at end of file
+}
+
+void page_get_stats(struct page_stats *st) {
+    *st = stats;
+    st->largest_free = 0;
+    for (size_t i = MAX_ORDER; i > 0; i--) {
+        if (stats.free_areas[i - 1]) {
+            st->largest_free = 1ul << (i - 1 + PAGE_SHIFT);
+            break;
+        }
+    }
+}
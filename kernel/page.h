@@ -3,8 +3,15 @@
 #ifndef _PAGE_H_
 #define _PAGE_H_
 
+#include <stdint.h>
+
 #include "fmem.h"
 
+// Size of a page is 2^PAGE_SHIFT bytes.
+#define PAGE_SHIFT 10
+// Allocations are sets of 2^order pages, with order < MAX_ORDER.
+#define MAX_ORDER 7
+
 struct page {
     void_fptr_t addr;
     size_t order;
@@ -21,4 +28,25 @@ struct page *page_alloc(size_t order);
 // page_free frees the set of pages referenced by |p|.
 void page_free(struct page *p);
 
+// Page allocator statistics, see page_get_stats().
+struct page_stats {
+    // Number of bytes managed by the allocator.
+    uint32_t total;
+    // Number of bytes currently allocated.
+    uint32_t in_use;
+    // Highest value reached by |in_use|.
+    uint32_t max_in_use;
+    // Number of successful allocations.
+    unsigned long allocs;
+    // Number of frees.
+    unsigned long frees;
+    // Number of free areas of 2^order pages, indexed by order.
+    size_t free_areas[MAX_ORDER];
+    // Size of the largest free area in bytes.
+    uint32_t largest_free;
+};
+
+// page_get_stats fills |st| with the current page allocator statistics.
+void page_get_stats(struct page_stats *st);
+
 #endif  // _PAGE_H_
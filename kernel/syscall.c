@@ -58,6 +58,11 @@ void breakpoint(uint16_t flags, uint16_t cs, uint16_t ip, uint16_t ax,
     printf("0x%04x [%04x]\n", (uint16_t)stack, *stack);
     stack++;
 
+    // Print the processes and their CPU usage.
+    printf("------- PROCESSES -------\n");
+    scheduler_dump();
+    printf("Console: %lu chars dropped\n", console_tx_dropped());
+
     // Hang forever but keep interrupts enabled to be able to print messages.
     sti();
     while (1) {
@@ -68,6 +73,8 @@ void breakpoint(uint16_t flags, uint16_t cs, uint16_t ip, uint16_t ax,
 int syscall_int21(uint16_t ax, uint16_t dx) {
     int ret = -1;
     uint8_t ah = ax >> 8;
+
+    scheduler_syscall_enter();
     switch (ah) {
         case 0x01:
             ret = console_getchar();
@@ -79,6 +86,7 @@ int syscall_int21(uint16_t ax, uint16_t dx) {
             ret = console_puts((const char *)dx);
             break;
     }
+    scheduler_syscall_exit();
     return ret;
 }
 
@@ -86,6 +94,7 @@ int syscall_int80(uint16_t nr, uint16_t arg0, uint16_t arg1, uint16_t arg2,
                   uint16_t arg3) {
     int ret = -1;
 
+    scheduler_syscall_enter();
     switch (nr) {
         case 0x0:
             ret = sys_read((int)arg0, (void *)arg1, (size_t)arg2);
@@ -99,6 +108,11 @@ int syscall_int80(uint16_t nr, uint16_t arg0, uint16_t arg1, uint16_t arg2,
         case 0x3:
             ret = sys_close((int)arg0);
             break;
+        case 0x10:
+            // The argument is 32 bits wide, e.g. for baud rates.
+            ret = sys_ioctl((int)arg0, (int)arg1,
+                            (uint32_t)arg3 << 16 | arg2);
+            break;
         case 0x27:
             ret = scheduler_getpid();
             break;
@@ -125,5 +139,6 @@ int syscall_int80(uint16_t nr, uint16_t arg0, uint16_t arg1, uint16_t arg2,
                                 (struct timespec *)arg3);
             break;
     }
+    scheduler_syscall_exit();
     return ret;
 }
\ No newline at end of file
@@ -1,8 +1,10 @@
 // Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
 
 #include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 
+#include "console.h"
 #include "error.h"
 #include "fs.h"
 #include "scheduler.h"
@@ -39,11 +41,15 @@ ssize_t sys_read(int fd, void *buf, size_t count) {
     if (!desc) {
         return ERR_INVAL;
     }
-    if (desc->type != DESC_FILE) {
-        return ERR_NOT_SUPP;
+    switch (desc->type) {
+        case DESC_FILE:
+            // TODO: handle offsets.
+            return fs_read_file(desc->handle.file, buf, 0, count);
+        case DESC_CONSOLE:
+            return console_read(buf, count);
+        default:
+            return ERR_NOT_SUPP;
     }
-    // TODO: handle offsets.
-    return fs_read_file(desc->handle.file, buf, 0, count);
 }
 
 ssize_t sys_write(int fd, const void *buf, size_t count) {
@@ -51,15 +57,38 @@ ssize_t sys_write(int fd, const void *buf, size_t count) {
     const struct descriptor *desc;
 
     current = scheduler_current();
+    if (!current) {
+        // The kernel prints before the scheduler gives it its descriptors.
+        return fd == 1 || fd == 2 ? console_write(buf, count) : ERR_INVAL;
+    }
     desc = task_get_desc(current, fd);
     if (!desc) {
         return ERR_INVAL;
     }
-    if (desc->type != DESC_FILE) {
-        return ERR_NOT_SUPP;
+    switch (desc->type) {
+        case DESC_FILE:
+            // TODO: handle offsets.
+            return fs_write_file(desc->handle.file, buf, 0, count);
+        case DESC_CONSOLE:
+            return console_write(buf, count);
+        default:
+            return ERR_NOT_SUPP;
+    }
+}
+
+int sys_ioctl(int fd, int request, uint32_t arg) {
+    const struct descriptor *desc;
+
+    desc = task_get_desc(scheduler_current(), fd);
+    if (!desc) {
+        return ERR_INVAL;
+    }
+    switch (desc->type) {
+        case DESC_CONSOLE:
+            return console_ioctl(request, arg);
+        default:
+            return ERR_NOT_SUPP;
     }
-    // TODO: handle offsets.
-    return fs_write_file(desc->handle.file, buf, 0, count);
 }
 
 int sys_close(int fd) {
@@ -78,6 +107,8 @@ int sys_close(int fd) {
         case DESC_DIR:
             fs_close_dir(desc->handle.dir);
             break;
+        case DESC_CONSOLE:
+            break;
         default:
             return ERR_NOT_SUPP;
     }
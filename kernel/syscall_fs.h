@@ -6,6 +6,7 @@
 int sys_open(const char *pathname, int flags, int mode);
 ssize_t sys_read(int fd, void *buf, size_t count);
 ssize_t sys_write(int fd, const void *buf, size_t count);
+int sys_ioctl(int fd, int request, uint32_t arg);
 int sys_close(int fd);
 int sys_mount(const char *source, const char *target,
               const char *filesystemtype);
@@ -3,6 +3,7 @@
 #include <fcntl.h>
 #include <stdarg.h>
 #include <stddef.h>
+#include <sys/ioctl.h>
 #include <sys/types.h>
 
 static int _open(const char *pathname, int flags, int mode) {
@@ -74,6 +75,23 @@ int close(int fd) {
     return ret;
 }
 
+int ioctl(int fd, int request, unsigned long arg) {
+    int ret;
+    __asm__ __volatile__(
+        "mov $0x10, %%ax\n"
+        "mov %1, %%bx\n"
+        "mov %2, %%cx\n"
+        "mov %3, %%dx\n"
+        "mov %4, %%si\n"
+        "int $0x80\n"
+        "mov %%ax, %0\n"
+        : "=r"(ret)
+        : "g"(fd), "g"(request), "g"((unsigned int)arg),
+          "g"((unsigned int)(arg >> 16))
+        : "ax", "bx", "cx", "dx", "si");
+    return ret;
+}
+
 int mount(const char *source, const char *target, const char *filesystemtype,
           unsigned long mountflags, const void *data) {
     int ret;
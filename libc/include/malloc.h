@@ -0,0 +1,69 @@
+// Copyright (C) 2023 - Damien Dejean <dam.dejean@gmail.com>
+
+#ifndef _MALLOC_H_
+#define _MALLOC_H_
+
+#include <stddef.h>
+
+// Number of block orders managed by the allocator, the largest block that is
+// not a multi-page allocation is 2^(MALLOC_ORDERS-1) bytes.
+#define MALLOC_ORDERS 13
+
+// Allocator statistics, see malloc_get_stats().
+struct malloc_stats {
+    // Number of bytes obtained from the system with sbrk().
+    size_t heap_size;
+    // Number of bytes currently allocated, as malloc_usable_size() reports.
+    size_t in_use;
+    // Highest value reached by <in_use>.
+    size_t max_in_use;
+    // Number of successful allocations.
+    unsigned long allocs;
+    // Number of frees.
+    unsigned long frees;
+    // Number of pages used as runs of small objects.
+    size_t runs;
+    // Number of free blocks of size 2^order, indexed by order.
+    size_t free_blocks[MALLOC_ORDERS];
+    // Size of the largest free block.
+    size_t largest_free;
+};
+
+// malloc allocates <size> bytes and returns a pointer to the allocated memory.
+// The memory is not initialized. If <size> is 0, then malloc returns either
+// NULL or a unique pointer value that can later be successfully passed to
+// free().
+void *malloc(size_t size);
+
+// calloc allocates memory for an array of nmemb elements of size bytes each and
+// returns a pointer to the allocated memory. The memory is set to zero. If
+// nmemb or size is 0, then calloc() returns either NULL, or a unique pointer
+// value that can later be successfully passed to free().
+void *calloc(size_t nmemb, size_t size);
+
+// free frees the memory space pointed to by <ptr>, which must have been
+// returned by a previous call to malloc(). Otherwise or if free(ptr) has
+// already been called before, undefined behavior occurs. If <ptr> is NULL, no
+// operation is performed.
+void free(void *ptr);
+
+// realloc changes the size of the memory block pointed to by <ptr> to <size>
+// bytes. The contents are unchanged up to the minimum of the old and new
+// sizes. The block is resized in place when possible, otherwise it is moved
+// and the old block is freed. If <ptr> is NULL, realloc is equivalent to
+// malloc(size). If <size> is 0, realloc is equivalent to free(ptr) and returns
+// NULL. On error, NULL is returned and the original block is left untouched.
+void *realloc(void *ptr, size_t size);
+
+// malloc_usable_size returns the number of usable bytes in the block pointed
+// to by <ptr>, which may be greater than the requested size. Returns 0 if <ptr>
+// is NULL.
+size_t malloc_usable_size(void *ptr);
+
+// malloc_get_stats fills <st> with the current allocator statistics.
+void malloc_get_stats(struct malloc_stats *st);
+
+// malloc_print_stats prints the allocator statistics on the console.
+void malloc_print_stats(void);
+
+#endif  // _MALLOC_H_
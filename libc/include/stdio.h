@@ -6,15 +6,78 @@
 #include <stdarg.h>
 #include <stddef.h>
 
+#define EOF (-1)
+
+// Buffering modes of a stream, see setvbuf().
+#define _IOFBF 0  // Fully buffered: written when the buffer is full.
+#define _IOLBF 1  // Line buffered: written at the end of each line.
+#define _IONBF 2  // Unbuffered: written immediately.
+
+// Size of the stream buffers.
+#define BUFSIZ 128
+
+// Output stream. Characters are accumulated in the stream buffer and handed to
+// the kernel with a single write per flush.
+typedef struct __file {
+    // File descriptor the stream writes to.
+    int fd;
+    // Buffering mode, one of _IOFBF, _IOLBF or _IONBF.
+    int mode;
+    // Set when a write to the file descriptor failed.
+    int error;
+    // Buffer memory and its size.
+    char* buf;
+    size_t size;
+    // Number of characters waiting in the buffer.
+    size_t len;
+    // Set while the buffer is updated. A write interrupting the update goes
+    // straight to the file descriptor.
+    char busy;
+} FILE;
+
+// Standard output, line buffered, and standard error, unbuffered.
+extern FILE* stdout;
+extern FILE* stderr;
+
 int sprintf(char* buffer, const char* format, ...);
 int snprintf(char* buffer, size_t count, const char* format, ...);
 int vsnprintf(char* buffer, size_t count, const char* format, va_list va);
 int vprintf(const char* format, va_list va);
+int vfprintf(FILE* stream, const char* format, va_list va);
 int fctprintf(void (*out)(char character, void* arg), void* arg,
               const char* format, ...);
 int printf(const char* format, ...);
+int fprintf(FILE* stream, const char* format, ...);
 int putchar(int c);
 int puts(const char* s);
 int getchar(void);
 
+// fputc writes the character <c> to <stream>. Returns <c> as an unsigned char,
+// or EOF on error.
+int fputc(int c, FILE* stream);
+
+// fputs writes the string <s> to <stream>, without its terminating '\0'.
+// Returns a nonnegative number on success, or EOF on error.
+int fputs(const char* s, FILE* stream);
+
+// fwrite writes <nmemb> items of <size> bytes from <ptr> to <stream>. Returns
+// the number of items written.
+size_t fwrite(const void* ptr, size_t size, size_t nmemb, FILE* stream);
+
+// fflush writes the buffered characters of <stream>, or of all the streams if
+// <stream> is NULL. Returns 0 on success, or EOF on error.
+int fflush(FILE* stream);
+
+// setvbuf sets the buffering <mode> of <stream>, using the buffer <buf> of
+// <size> bytes. A NULL <buf> keeps the current buffer. Pending characters are
+// flushed first. Returns 0 on success, nonzero if the mode is invalid or if a
+// buffered mode is requested without a buffer.
+int setvbuf(FILE* stream, char* buf, int mode, size_t size);
+
+// ferror returns nonzero if a write to <stream> failed.
+int ferror(FILE* stream);
+
+// clearerr resets the error indicator of <stream>.
+void clearerr(FILE* stream);
+
 #endif  // _STDIO_H_
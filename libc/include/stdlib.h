@@ -8,6 +8,7 @@
 extern void *malloc(size_t size);
 void *calloc(size_t nmemb, size_t size);
 extern void free(void *ptr);
+void *realloc(void *ptr, size_t size);
 
 __attribute__((__noreturn__)) void exit(int status);
 
@@ -14,6 +14,10 @@ void *memcpy(void *dst, const void *src, size_t count);
 
 int memcmp(const void *m1, const void *m2, size_t n);
 
+// memchr returns a pointer to the first occurrence of the least significant
+// byte of <c> in the <n> first bytes of <s>, NULL if there is none.
+void *memchr(const void *s, int c, size_t n);
+
 // strnlen returns the number of chars pointed by s (final '\0' excluded).
 size_t strlen(const char *s);
 
@@ -25,6 +29,9 @@ size_t strnlen(const char *s, size_t maxlen);
 // the result of the comparison.
 int strcmp(const char *s1, const char *s2);
 
+// strncmp compares at most the <n> first chars of <s1> and <s2>.
+int strncmp(const char *s1, const char *s2, size_t n);
+
 char *strdup(const char *s);
 
 char *strchr(const char *s, int c);
@@ -0,0 +1,29 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+
+#ifndef _IOCTL_H_
+#define _IOCTL_H_
+
+// Requests of the console descriptors.
+// Sets the line rate in bauds, e.g. 38400, up to 307200 on a 4.9152 MHz UART.
+#define CONSOLE_SET_BAUD_RATE 1
+// Sets the number of bytes in the RX FIFO raising an interrupt: 1, 4, 8 or 14.
+#define CONSOLE_SET_RX_TRIGGER 2
+// Sets the flow control modes, a combination of CONSOLE_FLOW_* flags.
+#define CONSOLE_SET_FLOW_CONTROL 3
+// Enables the canonical input mode if nonzero: the input is delivered line by
+// line.
+#define CONSOLE_SET_CANONICAL 4
+
+// Flow control modes, see CONSOLE_SET_FLOW_CONTROL.
+#define CONSOLE_FLOW_NONE 0
+// Hardware flow control: RTS pauses the sender, CTS pauses the transmission.
+#define CONSOLE_FLOW_RTSCTS (1 << 0)
+// Software flow control with XON/XOFF chars.
+#define CONSOLE_FLOW_XONXOFF (1 << 1)
+
+// ioctl configures the device referred to by the file descriptor |fd|
+// according to |request|, with the value |arg|. Returns 0 on success, a
+// negative error code otherwise.
+int ioctl(int fd, int request, unsigned long arg);
+
+#endif  // _IOCTL_H_
@@ -1,7 +1,22 @@
 // Copyright (C) 2023 - Damien Dejean <dam.dejean@gmail.com>
 //
-// Buddy memory allocator based on brk()/sbrk() to obtain heap memory. The
-// maximum allocation size is limited to 4K.
+// Memory allocator based on brk()/sbrk() to obtain heap memory. The heap is
+// grown by pages of 4K and requests are served by three allocators:
+//  - small requests (up to 64 bytes) are served from runs: pages split in
+//    objects of the same size class, without any per-object header,
+//  - medium requests are served by a buddy allocator inside the pages,
+//  - large requests span several contiguous pages.
+//
+// Every buddy block, free or allocated, starts with a tag holding its order and
+// its state. Free blocks are kept in doubly linked lists, one per order.
+// Checking if the buddy of a block is free is then a matter of reading the
+// buddy tag, and removing it from its free list does not require any list
+// traversal. A buddy block never crosses a page boundary, so the start of each
+// page holds a tag telling which allocator owns the page.
+//
+// Only the first page of a large allocation is tagged, the other ones hold user
+// data. Whole free pages are then also recorded in a bitmap outside the heap,
+// and the allocator only trusts the bitmap to tell if a page is free.
 
 #include "malloc.h"
 
@@ -12,51 +27,104 @@
 #include <unistd.h>
 
 // Heap, NULL at first and will grow with the allocations.
-char *heap;
+static char *heap;
 
 // Total heap size.
-int heap_size;
+static size_t heap_size;
+
+// Allocator statistics.
+static struct malloc_stats stats;
+
+// Possible states of a block.
+#define BLOCK_USED 0x55
+#define BLOCK_FREE 0xAA
+// The page is a run of small objects.
+#define BLOCK_RUN 0x5A
+// The page is the first of a large allocation.
+#define BLOCK_LARGE 0xA5
+
+// Tag present at the start of every block.
+struct block_tag {
+    // The block size is 2^order, or the size class for runs.
+    uint8_t order;
+    // One of the BLOCK_* states.
+    uint8_t state;
+};
 
 // Free block header.
 struct free_block {
+    struct block_tag tag;
+    struct free_block *prev;
     struct free_block *next;
 };
 
 // Allocated block header.
 struct block_header {
-    int size;
+    struct block_tag tag;
+    char mem[];
+};
+
+// Header of a large allocation.
+struct large_header {
+    struct block_tag tag;
+    // Number of pages of the allocation.
+    uint16_t pages;
     char mem[];
 };
 
-#define MAX_INDEX 12
-// Maximum allocable size at once.
+// Header of a run of small objects. Object offsets are relative to the run.
+struct run {
+    struct block_tag tag;
+    // Number of objects in use.
+    uint16_t used;
+    // Offset of the first object never allocated so far.
+    uint16_t bump;
+    // Offset of the first freed object, 0 if none.
+    uint16_t free;
+    // Runs of the same size class with available objects.
+    struct run *prev;
+    struct run *next;
+};
+
+#define MAX_INDEX (MALLOC_ORDERS - 1)
+// Size of the pages the heap is grown with, and maximum buddy block size.
 #define PAGE_SIZE (1 << MAX_INDEX)
-// Minimum memory block size.
-#define MIN_SIZE 8
+// Minimum memory block order, a free block must be able to hold its header.
+// This is 8 bytes on the target, host builds have larger pointers.
+#define MIN_INDEX (sizeof(struct free_block) <= 8 ? 3 : 5)
+
+// Maximum number of pages in the heap, by default the whole address space. It
+// can be lowered at build time.
+#ifndef MALLOC_MAX_PAGES
+#define MALLOC_MAX_PAGES ((size_t)-1 / PAGE_SIZE + 1)
+#endif
+
+// Array of free blocks lists.
+static struct free_block *fb_table[MAX_INDEX + 1];
+
+// Free pages of the heap, one bit per page.
+static uint8_t free_pages[(MALLOC_MAX_PAGES + 7) / 8];
 
-// Array of free blocks.
-static struct free_block fb_table[MAX_INDEX + 1];
+// Size classes of the small objects.
+static const uint8_t class_size[] = {4, 6, 8, 12, 16, 24, 32, 48, 64};
+#define NB_CLASSES (sizeof(class_size) / sizeof(class_size[0]))
+// Maximum size of a small object.
+#define SMALL_MAX 64
+// Size class of a small request of size s, indexed by (s + 1) / 2.
+static const uint8_t size_class[SMALL_MAX / 2 + 1] = {
+    0, 0, 0, 1, 2, 3, 3, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 8, 8, 8, 8, 8, 8, 8,
+};
+// Offset of the first object in a run.
+#define RUN_START ((sizeof(struct run) + 1) & ~1)
+
+// Runs with available objects, one list per size class.
+static struct run *runs[NB_CLASSES];
 
 // getindex returns the index of a block is size <size>.
 static int getindex(size_t size) {
-    static int min_index;
-    int index;
-    size_t block_size, sz;
-
-    // Compute the minimum size only once.
-    min_index = 0;
-    if (min_index == 0) {
-        sz = 1;
-        while (sz < MIN_SIZE) {
-            sz = sz << 1;
-            min_index++;
-        }
-    }
-
-    index = min_index;
-    block_size = MIN_SIZE;
-    while (block_size < size) {
-        block_size = block_size << 1;
+    int index = MIN_INDEX;
+    while (((size_t)1 << index) < size) {
         index++;
     }
     return index;
@@ -68,50 +136,110 @@ static void *getbuddy(int index, void *addr) {
     return heap + ((size_t)(1 << index) ^ ((size_t)addr - (size_t)heap));
 }
 
+// page_set_free records if the <page> is a whole free block.
+static void page_set_free(void *page, int free) {
+    size_t n = ((char *)page - heap) / PAGE_SIZE;
+
+    if (free) {
+        free_pages[n / 8] |= 1 << (n % 8);
+    } else {
+        free_pages[n / 8] &= ~(1 << (n % 8));
+    }
+}
+
+// page_is_free tells if <page> is in the heap and a whole free block.
+static int page_is_free(void *page) {
+    size_t n = ((char *)page - heap) / PAGE_SIZE;
+
+    if ((char *)page >= heap + heap_size) {
+        return 0;
+    }
+    return (free_pages[n / 8] >> (n % 8)) & 1;
+}
+
 // fb_add adds a free bloc of size 2^<index> starting at address <addr>
 static void fb_add(int index, void *address) {
-    ((struct free_block *)address)->next = fb_table[index].next;
-    fb_table[index].next = address;
+    struct free_block *block = address;
+    block->tag.order = index;
+    block->tag.state = BLOCK_FREE;
+    block->prev = NULL;
+    block->next = fb_table[index];
+    if (block->next) {
+        block->next->prev = block;
+    }
+    fb_table[index] = block;
+    stats.free_blocks[index]++;
+    if (index == MAX_INDEX) {
+        page_set_free(block, 1);
+    }
+}
+
+// fb_unlink removes <block> from the free list of its order.
+static void fb_unlink(struct free_block *block) {
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        fb_table[block->tag.order] = block->next;
+    }
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+    block->tag.state = BLOCK_USED;
+    stats.free_blocks[block->tag.order]--;
+    if (block->tag.order == MAX_INDEX) {
+        page_set_free(block, 0);
+    }
 }
 
 // fb_pop removes a block of size 2^<index>.
 static void *fb_pop(int index) {
-    struct free_block *block = fb_table[index].next;
-    if (block != NULL) fb_table[index].next = block->next;
+    struct free_block *block = fb_table[index];
+    if (block != NULL) fb_unlink(block);
     return block;
 }
 
 // fb_remove removes a free block at <index> with address <addr>.
 static int fb_remove(int index, void *address) {
-    struct free_block *block = &(fb_table[index]);
-    while (block->next != NULL && block->next != address) block = block->next;
-    if (block->next == address) {
-        block->next = block->next->next;
-        return 1;
-    } else {
+    struct free_block *block = address;
+    if (block->tag.state != BLOCK_FREE || block->tag.order != index) {
         return 0;
     }
+    fb_unlink(block);
+    return 1;
 }
 
-void *malloc(size_t size) {
-    int index, i;
-    struct block_header *header;
-    size_t full_size;
+// page_of returns the start of the page containing <ptr>.
+static char *page_of(void *ptr) {
+    return heap + (((size_t)ptr - (size_t)heap) & ~(size_t)(PAGE_SIZE - 1));
+}
+
+// header_of returns the header of the buddy block allocated at <ptr>.
+static struct block_header *header_of(void *ptr) {
+    return (struct block_header *)((char *)ptr -
+                                   offsetof(struct block_header, mem));
+}
+
+// heap_grow extends the heap by <pages> pages and returns the first one.
+static void *heap_grow(size_t pages) {
     void *zone;
 
-    if (!size) {
+    if (pages > MALLOC_MAX_PAGES - heap_size / PAGE_SIZE) {
         return NULL;
     }
-
-    // Initialize the heap if this is the first time.
-    if (!heap) {
-        heap = sbrk(0);
+    if (sbrk(pages * PAGE_SIZE) == (void *)-1) {
+        // No more memory available at all.
+        return NULL;
     }
+    zone = heap + heap_size;
+    heap_size += pages * PAGE_SIZE;
+    return zone;
+}
 
-    full_size = size + sizeof(struct block_header);
-    index = getindex(full_size);
-    i = index;
-    if (index > MAX_INDEX) return NULL;
+// buddy_alloc returns a block of size 2^<index>, tagged as used.
+static void *buddy_alloc(int index) {
+    struct block_header *header;
+    int i = index;
+    void *zone;
 
     // Get the smallest free bloc.
     zone = fb_pop(i);
@@ -121,12 +249,10 @@ void *malloc(size_t size) {
 
     // No more memory available, get some.
     if (zone == NULL) {
-        if (sbrk(PAGE_SIZE) == (void *)-1) {
-            // No more memory available at all.
+        zone = heap_grow(1);
+        if (zone == NULL) {
             return NULL;
         }
-        zone = heap + heap_size;
-        heap_size += PAGE_SIZE;
         i = MAX_INDEX;
     }
 
@@ -137,15 +263,321 @@ void *malloc(size_t size) {
 
     // Prepare the header.
     header = zone;
-    header->size = full_size;
+    header->tag.order = index;
+    header->tag.state = BLOCK_USED;
+    return zone;
+}
+
+// buddy_free releases the buddy block starting at <zone>.
+static void buddy_free(void *zone) {
+    int i = ((struct block_tag *)zone)->order;
+    void *buddy = getbuddy(i, zone);
+
+    // Obtain the free buddies while there is some.
+    while (i < MAX_INDEX && fb_remove(i, buddy)) {
+        zone = (zone <= buddy) ? zone : buddy;
+        buddy = getbuddy(++i, zone);
+    }
+
+    // Insert the big free block.
+    fb_add(i, zone);
+}
+
+// run_link adds <run> in the list of runs with available objects. The run is
+// inserted after the current head so that allocations keep filling the same
+// run instead of bouncing between almost full ones.
+static void run_link(struct run *run) {
+    struct run *head = runs[run->tag.order];
+
+    if (!head) {
+        run->prev = NULL;
+        run->next = NULL;
+        runs[run->tag.order] = run;
+        return;
+    }
+    run->prev = head;
+    run->next = head->next;
+    if (run->next) {
+        run->next->prev = run;
+    }
+    head->next = run;
+}
+
+// run_unlink removes <run> from the list of runs with available objects.
+static void run_unlink(struct run *run) {
+    if (run->prev) {
+        run->prev->next = run->next;
+    } else {
+        runs[run->tag.order] = run->next;
+    }
+    if (run->next) {
+        run->next->prev = run->prev;
+    }
+}
+
+// run_is_full tells if all the objects of <run> are in use.
+static int run_is_full(const struct run *run) {
+    return !run->free && run->bump + class_size[run->tag.order] > PAGE_SIZE;
+}
+
+// run_alloc returns an object of size class <class>.
+static void *run_alloc(int class) {
+    struct run *run = runs[class];
+    char *obj;
+
+    if (!run) {
+        // Start a new run in a free page. Objects are carved lazily.
+        run = buddy_alloc(MAX_INDEX);
+        if (!run) {
+            return NULL;
+        }
+        run->tag.order = class;
+        run->tag.state = BLOCK_RUN;
+        run->used = 0;
+        run->bump = RUN_START;
+        run->free = 0;
+        run_link(run);
+        stats.runs++;
+    }
+
+    if (run->free) {
+        obj = (char *)run + run->free;
+        run->free = *(uint16_t *)obj;
+    } else {
+        obj = (char *)run + run->bump;
+        run->bump += class_size[class];
+    }
+    run->used++;
+    if (run_is_full(run)) {
+        run_unlink(run);
+    }
+    return obj;
+}
+
+// run_free releases the object <obj> from <run>.
+static void run_free(struct run *run, char *obj) {
+    int was_full = run_is_full(run);
+
+    *(uint16_t *)obj = run->free;
+    run->free = obj - (char *)run;
+    run->used--;
+
+    if (!run->used) {
+        // The run is empty, give the page back.
+        if (!was_full) {
+            run_unlink(run);
+        }
+        run->tag.order = MAX_INDEX;
+        run->tag.state = BLOCK_USED;
+        buddy_free(run);
+        stats.runs--;
+    } else if (was_full) {
+        run_link(run);
+    }
+}
+
+// pages_find looks for <pages> contiguous free pages and removes them from the
+// free list.
+static void *pages_find(size_t pages) {
+    struct free_block *block;
+    struct free_block *page;
+    size_t i;
+
+    for (block = fb_table[MAX_INDEX]; block; block = block->next) {
+        for (i = 1; i < pages; i++) {
+            page = (struct free_block *)((char *)block + i * PAGE_SIZE);
+            if (!page_is_free(page)) {
+                break;
+            }
+        }
+        if (i == pages) {
+            for (i = 0; i < pages; i++) {
+                fb_unlink((struct free_block *)((char *)block + i * PAGE_SIZE));
+            }
+            return block;
+        }
+    }
+    return NULL;
+}
+
+// large_pages returns the number of pages needed by a large allocation of
+// <size> bytes, 0 on overflow.
+static size_t large_pages(size_t size) {
+    size_t full_size = size + sizeof(struct large_header);
+    if (full_size < size) return 0;
+    return full_size / PAGE_SIZE + ((full_size & (PAGE_SIZE - 1)) != 0);
+}
+
+// large_alloc returns an allocation of <size> bytes spanning several pages.
+static void *large_alloc(size_t size) {
+    struct large_header *header;
+    size_t pages = large_pages(size);
+
+    if (!pages) return NULL;
+    header = pages_find(pages);
+    if (!header) {
+        header = heap_grow(pages);
+        if (!header) {
+            return NULL;
+        }
+    }
+
+    header->tag.order = MAX_INDEX;
+    header->tag.state = BLOCK_LARGE;
+    header->pages = pages;
     return (void *)header->mem;
 }
 
+// large_free releases the pages of the large allocation <header>.
+static void large_free(struct large_header *header) {
+    char *page = (char *)header;
+    size_t pages = header->pages;
+
+    for (size_t i = 0; i < pages; i++) {
+        fb_add(MAX_INDEX, page + i * PAGE_SIZE);
+    }
+}
+
+// large_resize resizes in place the large allocation <header> to <pages>
+// pages. Returns 1 on success, 0 if the following pages are not available.
+static int large_resize(struct large_header *header, size_t pages) {
+    char *page = (char *)header;
+    struct free_block *next;
+    size_t i, end;
+
+    // Shrink: give the trailing pages back.
+    if (pages <= header->pages) {
+        for (i = pages; i < header->pages; i++) {
+            fb_add(MAX_INDEX, page + i * PAGE_SIZE);
+        }
+        header->pages = pages;
+        return 1;
+    }
+
+    // Grow: the following pages must be free, or beyond the end of the heap.
+    for (end = header->pages; end < pages; end++) {
+        next = (struct free_block *)(page + end * PAGE_SIZE);
+        if ((char *)next >= heap + heap_size) {
+            break;
+        }
+        if (!page_is_free(next)) {
+            return 0;
+        }
+    }
+    if (end < pages && !heap_grow(pages - end)) {
+        return 0;
+    }
+    for (i = header->pages; i < end; i++) {
+        fb_unlink((struct free_block *)(page + i * PAGE_SIZE));
+    }
+    header->pages = pages;
+    return 1;
+}
+
+// buddy_resize resizes in place the buddy block <header> to order <index>.
+// Growing requires the upper buddies to be free. Returns 1 on success, 0
+// otherwise.
+static int buddy_resize(struct block_header *header, int index) {
+    struct free_block *buddy;
+    int i;
+
+    // Check that all the buddies to merge are free before taking any of them.
+    for (i = header->tag.order; i < index; i++) {
+        buddy = getbuddy(i, header);
+        if ((void *)buddy < (void *)header || buddy->tag.state != BLOCK_FREE ||
+            buddy->tag.order != i) {
+            return 0;
+        }
+    }
+    for (i = header->tag.order; i < index; i++) {
+        fb_unlink(getbuddy(i, header));
+    }
+
+    // Split the block when shrinking, the upper halves are free.
+    for (i = header->tag.order; i > index;) {
+        i--;
+        fb_add(i, getbuddy(i, header));
+    }
+
+    header->tag.order = index;
+    return 1;
+}
+
+// heap_alloc returns a block of at least <size> bytes from the allocator
+// matching the request size.
+static void *heap_alloc(size_t size) {
+    struct block_header *header;
+    size_t full_size;
+
+    // Initialize the heap if this is the first time.
+    if (!heap) {
+        heap = sbrk(0);
+    }
+
+    if (size <= SMALL_MAX) {
+        return run_alloc(size_class[(size + 1) >> 1]);
+    }
+
+    full_size = size + sizeof(struct block_header);
+    if (full_size < size || full_size > PAGE_SIZE) {
+        return large_alloc(size);
+    }
+
+    header = buddy_alloc(getindex(full_size));
+    if (!header) {
+        return NULL;
+    }
+    return (void *)header->mem;
+}
+
+// heap_free gives <ptr> back to the allocator that owns it.
+static void heap_free(void *ptr) {
+    struct block_tag *page;
+
+    // The first page tag tells which allocator owns the pointer.
+    page = (struct block_tag *)page_of(ptr);
+    if (page->state == BLOCK_RUN) {
+        run_free((struct run *)page, ptr);
+    } else if (page->state == BLOCK_LARGE &&
+               ptr == ((struct large_header *)page)->mem) {
+        large_free((struct large_header *)page);
+    } else {
+        buddy_free(header_of(ptr));
+    }
+}
+
+// stats_update accounts <freed> and <allocated> bytes in the statistics.
+static void stats_update(size_t freed, size_t allocated) {
+    stats.in_use = stats.in_use - freed + allocated;
+    if (stats.in_use > stats.max_in_use) {
+        stats.max_in_use = stats.in_use;
+    }
+}
+
+void *malloc(size_t size) {
+    void *ptr;
+
+    if (!size) {
+        return NULL;
+    }
+
+    ptr = heap_alloc(size);
+    if (ptr) {
+        stats.allocs++;
+        stats_update(0, malloc_usable_size(ptr));
+    }
+    return ptr;
+}
+
 void *calloc(size_t nmemb, size_t size) {
     size_t sz = nmemb * size;
     if (!sz) {
         return NULL;
     }
+    if (sz / size != nmemb) {
+        // Overflow.
+        return NULL;
+    }
     void *ptr = malloc(sz);
     if (!ptr) {
         return NULL;
@@ -155,25 +587,107 @@ void *calloc(size_t nmemb, size_t size) {
 }
 
 void free(void *ptr) {
-    int i;
-    void *zone, *buddy;
+    if (!ptr) {
+        return;
+    }
+
+    stats.frees++;
+    stats_update(malloc_usable_size(ptr), 0);
+    heap_free(ptr);
+}
+
+void *realloc(void *ptr, size_t size) {
+    struct block_tag *page;
+    size_t full_size, pages, usable;
+    int resized = 0;
+    void *new;
+
+    if (!ptr) {
+        return malloc(size);
+    }
+    if (!size) {
+        free(ptr);
+        return NULL;
+    }
+
+    // Try to resize the allocation in place.
+    usable = malloc_usable_size(ptr);
+    page = (struct block_tag *)page_of(ptr);
+    full_size = size + sizeof(struct block_header);
+    if (page->state == BLOCK_RUN) {
+        resized = size <= class_size[page->order];
+    } else if (page->state == BLOCK_LARGE &&
+               ptr == ((struct large_header *)page)->mem) {
+        pages = large_pages(size);
+        resized = pages && large_resize((struct large_header *)page, pages);
+    } else if (full_size >= size && full_size <= PAGE_SIZE) {
+        resized = buddy_resize(header_of(ptr), getindex(full_size));
+    }
+    if (resized) {
+        stats_update(usable, malloc_usable_size(ptr));
+        return ptr;
+    }
+
+    // Move the allocation.
+    new = malloc(size);
+    if (!new) {
+        return NULL;
+    }
+    memcpy(new, ptr, usable < size ? usable : size);
+    free(ptr);
+    return new;
+}
+
+size_t malloc_usable_size(void *ptr) {
+    struct block_tag *page;
     struct block_header *header;
 
     if (!ptr) {
-        return;
+        return 0;
     }
 
-    zone = (char *)ptr - offsetof(struct block_header, mem);
-    header = (struct block_header *)zone;
-    i = getindex(header->size);
-    buddy = getbuddy(i, zone);
+    page = (struct block_tag *)page_of(ptr);
+    if (page->state == BLOCK_RUN) {
+        return class_size[page->order];
+    }
+    if (page->state == BLOCK_LARGE &&
+        ptr == ((struct large_header *)page)->mem) {
+        return ((struct large_header *)page)->pages * PAGE_SIZE -
+               sizeof(struct large_header);
+    }
+    header = header_of(ptr);
+    return ((size_t)1 << header->tag.order) - sizeof(struct block_header);
+}
 
-    // Obtain the free buddies while there is some.
-    while (i < MAX_INDEX && fb_remove(i, buddy)) {
-        zone = (zone <= buddy) ? zone : buddy;
-        buddy = getbuddy(++i, zone);
+void malloc_get_stats(struct malloc_stats *st) {
+    int i;
+
+    *st = stats;
+    st->heap_size = heap_size;
+    st->largest_free = 0;
+    for (i = MAX_INDEX; i >= 0; i--) {
+        if (stats.free_blocks[i]) {
+            st->largest_free = (size_t)1 << i;
+            break;
+        }
     }
+}
 
-    // Insert the big free block.
-    fb_add(i, zone);
+void malloc_print_stats(void) {
+    struct malloc_stats st;
+    int i;
+
+    malloc_get_stats(&st);
+    printf("malloc: heap: %u bytes, in use: %u bytes (max %u), runs: %u\n",
+           (unsigned int)st.heap_size, (unsigned int)st.in_use,
+           (unsigned int)st.max_in_use, (unsigned int)st.runs);
+    printf("malloc: allocs: %lu, frees: %lu, largest free block: %u bytes\n",
+           st.allocs, st.frees, (unsigned int)st.largest_free);
+    printf("malloc: free blocks:");
+    for (i = 0; i < MALLOC_ORDERS; i++) {
+        if (st.free_blocks[i]) {
+            printf(" %u*%u", (unsigned int)st.free_blocks[i], 1u << i);
+        }
+    }
+    printf("\n");
 }
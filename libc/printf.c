@@ -139,14 +139,36 @@ static inline void _out_null(char character, void* buffer, size_t idx,
     (void)maxlen;
 }
 
-// internal _putchar wrapper
-static inline void _out_char(char character, void* buffer, size_t idx,
-                             size_t maxlen) {
-    (void)buffer;
+// internal stream output, buffer is the FILE pointer
+static inline void _out_stream(char character, void* buffer, size_t idx,
+                               size_t maxlen) {
     (void)idx;
     (void)maxlen;
     if (character) {
-        putchar(character);
+        fputc(character, (FILE*)buffer);
+    }
+}
+
+// Output of a formatted string to an unbuffered stream, see vfprintf().
+typedef struct {
+    FILE* stream;
+    size_t len;
+    char buf[32];
+} out_chunk_type;
+
+// internal unbuffered stream output, buffer is the out_chunk_type pointer
+static inline void _out_chunk(char character, void* buffer, size_t idx,
+                              size_t maxlen) {
+    out_chunk_type* chunk = (out_chunk_type*)buffer;
+    (void)idx;
+    (void)maxlen;
+    if (!character) {
+        return;
+    }
+    chunk->buf[chunk->len++] = character;
+    if (chunk->len == sizeof(chunk->buf)) {
+        fwrite(chunk->buf, 1, chunk->len, chunk->stream);
+        chunk->len = 0;
     }
 }
 
@@ -921,8 +943,25 @@ int snprintf(char* buffer, size_t count, const char* format, ...) {
 }
 
 int vprintf(const char* format, va_list va) {
-    char buffer[1];
-    return _vsnprintf(_out_char, buffer, (size_t)-1, format, va);
+    return vfprintf(stdout, format, va);
+}
+
+int vfprintf(FILE* stream, const char* format, va_list va) {
+    out_chunk_type chunk;
+    int ret;
+
+    if (stream->mode != _IONBF) {
+        return _vsnprintf(_out_stream, (char*)stream, (size_t)-1, format, va);
+    }
+    // Unbuffered streams are written by chunks from the stack rather than char
+    // by char.
+    chunk.stream = stream;
+    chunk.len = 0;
+    ret = _vsnprintf(_out_chunk, (char*)&chunk, (size_t)-1, format, va);
+    if (chunk.len) {
+        fwrite(chunk.buf, 1, chunk.len, stream);
+    }
+    return ret;
 }
 
 int vsnprintf(char* buffer, size_t count, const char* format, va_list va) {
@@ -943,8 +982,15 @@ int fctprintf(void (*out)(char character, void* arg), void* arg,
 int printf(const char* format, ...) {
     va_list va;
     va_start(va, format);
-    char buffer[1];
-    const int ret = _vsnprintf(_out_char, buffer, (size_t)-1, format, va);
+    const int ret = vfprintf(stdout, format, va);
+    va_end(va);
+    return ret;
+}
+
+int fprintf(FILE* stream, const char* format, ...) {
+    va_list va;
+    va_start(va, format);
+    const int ret = vfprintf(stream, format, va);
     va_end(va);
     return ret;
 }
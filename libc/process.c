@@ -1,5 +1,6 @@
 // Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/resource.h>
@@ -7,6 +8,7 @@
 #include <sys/wait.h>
 
 __attribute__((__noreturn__)) void exit(int status) {
+    fflush(NULL);
     __asm__ __volatile__(
         "mov $0x3c, %%ax\n"
         "mov %0, %%bx\n"
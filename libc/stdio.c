@@ -0,0 +1,183 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// Buffer of the standard output.
+static char stdout_buf[BUFSIZ];
+
+static FILE stdout_file = {
+    .fd = 1,
+    .mode = _IOLBF,
+    .buf = stdout_buf,
+    .size = sizeof(stdout_buf),
+};
+
+static FILE stderr_file = {
+    .fd = 2,
+    .mode = _IONBF,
+};
+
+FILE *stdout = &stdout_file;
+FILE *stderr = &stderr_file;
+
+// stream_write writes <len> bytes from <data> to the file descriptor of
+// <stream>, bypassing its buffer. Short writes are resumed as long as the
+// file descriptor makes progress.
+static int stream_write(FILE *stream, const char *data, size_t len) {
+    ssize_t n;
+
+    while (len) {
+        n = write(stream->fd, data, len);
+        if (n <= 0) {
+            stream->error = 1;
+            return EOF;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// stream_lock takes the buffer of <stream>. Returns 0 if it's already taken:
+// the caller interrupted an update of the buffer, by an interrupt handler or
+// another thread. The flag is tested and set with a single instruction.
+static int stream_lock(FILE *stream) {
+    char busy = 1;
+
+    __asm__ __volatile__("xchgb %0, %1" : "+q"(busy), "+m"(stream->busy));
+    return !busy;
+}
+
+static inline void stream_unlock(FILE *stream) { stream->busy = 0; }
+
+int fflush(FILE *stream) {
+    int ret;
+
+    if (!stream) {
+        ret = fflush(stdout);
+        return fflush(stderr) ? EOF : ret;
+    }
+    // The interrupted owner of the buffer flushes it.
+    if (!stream_lock(stream)) {
+        return 0;
+    }
+    ret = 0;
+    if (stream->len) {
+        // Pending chars are dropped on error.
+        ret = stream_write(stream, stream->buf, stream->len);
+        stream->len = 0;
+    }
+    stream_unlock(stream);
+    return ret;
+}
+
+int setvbuf(FILE *stream, char *buf, int mode, size_t size) {
+    if (mode != _IOFBF && mode != _IOLBF && mode != _IONBF) {
+        return -1;
+    }
+    if (mode != _IONBF && (buf ? !size : !stream->buf)) {
+        return -1;
+    }
+
+    fflush(stream);
+    stream->mode = mode;
+    if (buf) {
+        stream->buf = buf;
+        stream->size = size;
+    }
+    return 0;
+}
+
+int ferror(FILE *stream) { return stream->error; }
+
+void clearerr(FILE *stream) { stream->error = 0; }
+
+int fputc(int c, FILE *stream) {
+    char ch = (char)c;
+    int flush;
+
+    if (stream->mode == _IONBF || !stream_lock(stream)) {
+        return stream_write(stream, &ch, 1) ? EOF : (unsigned char)ch;
+    }
+
+    stream->buf[stream->len++] = ch;
+    flush = stream->len == stream->size ||
+            (stream->mode == _IOLBF && ch == '\n');
+    stream_unlock(stream);
+    if (flush && fflush(stream)) {
+        return EOF;
+    }
+    return (unsigned char)ch;
+}
+
+size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *stream) {
+    const char *data = ptr;
+    size_t len;
+    size_t room;
+    int flush;
+
+    // The total length wraps around easily with a 16-bit size_t.
+    if (nmemb && size > (size_t)-1 / nmemb) {
+        stream->error = 1;
+        return 0;
+    }
+    len = size * nmemb;
+    if (!len) {
+        return 0;
+    }
+
+    if (stream->mode == _IONBF || len >= stream->size) {
+        // Large writes skip the buffer, once the pending chars are out.
+        if (fflush(stream) || stream_write(stream, data, len)) {
+            return 0;
+        }
+        return nmemb;
+    }
+    if (!stream_lock(stream)) {
+        return stream_write(stream, data, len) ? 0 : nmemb;
+    }
+
+    // Fill the buffer, write it when it is full and keep the remaining chars.
+    room = stream->size - stream->len;
+    if (len >= room) {
+        memcpy(stream->buf + stream->len, data, room);
+        data += room;
+        len -= room;
+        flush = stream_write(stream, stream->buf, stream->size);
+        stream->len = 0;
+        if (flush) {
+            stream_unlock(stream);
+            return 0;
+        }
+    }
+    memcpy(stream->buf + stream->len, data, len);
+    stream->len += len;
+    stream_unlock(stream);
+
+    // Line buffered streams are written as soon as a line is complete.
+    if (stream->mode == _IOLBF && memchr(ptr, '\n', size * nmemb)) {
+        if (fflush(stream)) {
+            return 0;
+        }
+    }
+    return nmemb;
+}
+
+int fputs(const char *s, FILE *stream) {
+    size_t len = strlen(s);
+    return fwrite(s, 1, len, stream) == len ? (int)len : EOF;
+}
+
+int putchar(int c) { return fputc(c, stdout); }
+
+int puts(const char *s) {
+    int len = fputs(s, stdout);
+
+    if (len == EOF || fputc('\n', stdout) == EOF) {
+        return EOF;
+    }
+    return len + 1;
+}
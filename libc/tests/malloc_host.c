@@ -0,0 +1,31 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+//
+// Builds the libc allocator for the host. Public symbols are renamed to avoid
+// any clash with the host C library, and the heap is backed by a static arena
+// instead of the brk syscall.
+
+#define MALLOC_HOST_KEEP_NAMES
+#include "malloc_host.h"
+
+#include <stdint.h>
+
+// Memory the test heap grows into.
+static char arena[MALLOC_HOST_ARENA_SIZE];
+// Current break in the arena.
+static size_t arena_brk;
+
+void *libc_sbrk(intptr_t increment) {
+    void *start = arena + arena_brk;
+    if (increment < 0 || arena_brk + increment > sizeof(arena)) {
+        return (void *)-1;
+    }
+    arena_brk += increment;
+    return start;
+}
+
+size_t libc_heap_brk(void) { return arena_brk; }
+
+// The heap can't grow past the arena.
+#define MALLOC_MAX_PAGES (MALLOC_HOST_ARENA_SIZE / 4096)
+
+#include "../malloc.c"
@@ -0,0 +1,43 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+
+#ifndef _MALLOC_HOST_H_
+#define _MALLOC_HOST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Size of the static arena backing the host heap.
+#define MALLOC_HOST_ARENA_SIZE (1 << 22)
+
+// The public symbols of the allocator are prefixed with libc_ to avoid any
+// clash with the host C library.
+#define malloc libc_malloc
+#define calloc libc_calloc
+#define free libc_free
+#define realloc libc_realloc
+#define malloc_usable_size libc_malloc_usable_size
+#define malloc_get_stats libc_malloc_get_stats
+#define malloc_print_stats libc_malloc_print_stats
+#define sbrk libc_sbrk
+
+#include "../include/malloc.h"
+
+// The allocator itself is built with the renamed symbols.
+#ifndef MALLOC_HOST_KEEP_NAMES
+#undef malloc
+#undef calloc
+#undef free
+#undef realloc
+#undef malloc_usable_size
+#undef malloc_get_stats
+#undef malloc_print_stats
+#undef sbrk
+#endif
+
+// libc_sbrk replaces sbrk() and grows the heap in the static arena.
+void *libc_sbrk(intptr_t increment);
+
+// libc_heap_brk returns the number of arena bytes handed to the allocator.
+size_t libc_heap_brk(void);
+
+#endif  // _MALLOC_HOST_H_
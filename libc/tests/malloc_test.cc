@@ -0,0 +1,438 @@
+// Copyright (C) 2024 - Damien Dejean <dam.dejean@gmail.com>
+
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+extern "C" {
+#include "malloc_host.h"
+}
+
+// Size of the pages the heap grows with.
+#define PAGE_SIZE 4096
+// Largest request served by the size class runs.
+#define SMALL_MAX 64
+// Largest request served by the buddy allocator.
+#define MAX_BUDDY_ALLOC (PAGE_SIZE - 2)
+
+struct allocation {
+    unsigned char *ptr;
+    size_t size;
+    unsigned char pattern;
+};
+
+static void fill(struct allocation *a) { memset(a->ptr, a->pattern, a->size); }
+
+static bool check(const struct allocation *a) {
+    for (size_t i = 0; i < a->size; i++) {
+        if (a->ptr[i] != a->pattern) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST(MallocTest, ZeroSize) { EXPECT_EQ(NULL, libc_malloc(0)); }
+
+TEST(MallocTest, SmallObjectsArePacked) {
+    unsigned char *a = (unsigned char *)libc_malloc(9);
+    unsigned char *b = (unsigned char *)libc_malloc(9);
+    unsigned char *c = (unsigned char *)libc_malloc(9);
+    ASSERT_NE(nullptr, a);
+    ASSERT_NE(nullptr, b);
+    ASSERT_NE(nullptr, c);
+
+    // 9 bytes requests are served by the 12 bytes size class.
+    EXPECT_EQ(12, b - a);
+    EXPECT_EQ(12, c - b);
+
+    // A freed object is reused first.
+    libc_free(b);
+    EXPECT_EQ(b, libc_malloc(12));
+    libc_free(a);
+    libc_free(b);
+    libc_free(c);
+}
+
+TEST(MallocTest, SmallObjectsFillRuns) {
+    std::vector<struct allocation> allocs(2000);
+
+    // Fill more than one run of the smallest class.
+    for (size_t i = 0; i < allocs.size(); i++) {
+        allocs[i].size = 1 + i % 4;
+        allocs[i].pattern = (unsigned char)i;
+        allocs[i].ptr = (unsigned char *)libc_malloc(allocs[i].size);
+        ASSERT_NE(nullptr, allocs[i].ptr);
+        fill(&allocs[i]);
+    }
+    for (auto &a : allocs) {
+        EXPECT_TRUE(check(&a));
+        libc_free(a.ptr);
+    }
+}
+
+TEST(MallocTest, LargeAllocation) {
+    struct allocation a = {nullptr, 3 * PAGE_SIZE + 17, 0x5a};
+    a.ptr = (unsigned char *)libc_malloc(a.size);
+    ASSERT_NE(nullptr, a.ptr);
+    fill(&a);
+
+    // The pages of the allocation can be used by other allocators.
+    void *small = libc_malloc(5);
+    void *medium = libc_malloc(300);
+    ASSERT_NE(nullptr, small);
+    ASSERT_NE(nullptr, medium);
+    EXPECT_TRUE(check(&a));
+    libc_free(a.ptr);
+    libc_free(small);
+    libc_free(medium);
+
+    // Freed pages are reused by the next large allocation.
+    size_t brk = libc_heap_brk();
+    a.ptr = (unsigned char *)libc_malloc(a.size);
+    ASSERT_NE(nullptr, a.ptr);
+    EXPECT_EQ(brk, libc_heap_brk());
+    libc_free(a.ptr);
+
+    EXPECT_EQ(nullptr, libc_malloc(MALLOC_HOST_ARENA_SIZE));
+}
+
+TEST(MallocTest, LargeAllocationHoldsTags) {
+    struct malloc_stats before_st, st;
+    libc_malloc_get_stats(&before_st);
+
+    // Every byte of the pages looks like the tag of a free page: order 12,
+    // then the free state.
+    struct allocation a = {nullptr, 3 * PAGE_SIZE, 0};
+    a.ptr = (unsigned char *)libc_malloc(a.size);
+    ASSERT_NE(nullptr, a.ptr);
+    for (size_t i = 0; i < a.size; i++) {
+        a.ptr[i] = i & 1 ? 0xaa : MALLOC_ORDERS - 1;
+    }
+    unsigned char *copy = (unsigned char *)malloc(a.size);
+    ASSERT_NE(nullptr, copy);
+    memcpy(copy, a.ptr, a.size);
+
+    // Neighbouring large allocations grow and get allocated without taking
+    // the pages of <a> for free pages.
+    unsigned char *before = (unsigned char *)libc_malloc(PAGE_SIZE);
+    unsigned char *after = (unsigned char *)libc_malloc(PAGE_SIZE);
+    ASSERT_NE(nullptr, before);
+    ASSERT_NE(nullptr, after);
+    before = (unsigned char *)libc_realloc(before, 4 * PAGE_SIZE);
+    ASSERT_NE(nullptr, before);
+    memset(before, 0x11, 4 * PAGE_SIZE);
+    after = (unsigned char *)libc_realloc(after, 4 * PAGE_SIZE);
+    ASSERT_NE(nullptr, after);
+    memset(after, 0x22, 4 * PAGE_SIZE);
+    void *other = libc_malloc(2 * PAGE_SIZE);
+    ASSERT_NE(nullptr, other);
+    memset(other, 0x33, 2 * PAGE_SIZE);
+    EXPECT_EQ(0, memcmp(copy, a.ptr, a.size));
+
+    libc_free(before);
+    libc_free(after);
+    libc_free(other);
+    libc_free(a.ptr);
+    free(copy);
+
+    libc_malloc_get_stats(&st);
+    EXPECT_EQ(before_st.in_use, st.in_use);
+    EXPECT_EQ(before_st.free_blocks[MALLOC_ORDERS - 1] +
+                  (st.heap_size - before_st.heap_size) / PAGE_SIZE,
+              st.free_blocks[MALLOC_ORDERS - 1]);
+}
+
+TEST(MallocTest, FreeNull) { libc_free(NULL); }
+
+TEST(MallocTest, Calloc) {
+    unsigned char *p = (unsigned char *)libc_malloc(64);
+    ASSERT_NE(nullptr, p);
+    memset(p, 0xff, 64);
+    libc_free(p);
+
+    p = (unsigned char *)libc_calloc(16, 4);
+    ASSERT_NE(nullptr, p);
+    for (int i = 0; i < 64; i++) {
+        EXPECT_EQ(0, p[i]);
+    }
+    libc_free(p);
+}
+
+TEST(MallocTest, NoOverlap) {
+    struct allocation allocs[64];
+
+    for (int i = 0; i < 64; i++) {
+        allocs[i].size = 1 + i * 7;
+        allocs[i].pattern = (unsigned char)i;
+        allocs[i].ptr = (unsigned char *)libc_malloc(allocs[i].size);
+        ASSERT_NE(nullptr, allocs[i].ptr);
+        fill(&allocs[i]);
+    }
+    for (int i = 0; i < 64; i++) {
+        EXPECT_TRUE(check(&allocs[i]));
+        libc_free(allocs[i].ptr);
+    }
+}
+
+TEST(MallocTest, FreeCoalesces) {
+    std::vector<void *> ptrs;
+
+    // Split a full page in small blocks, then release them in an order that
+    // prevents immediate merges.
+    void *big = libc_malloc(MAX_BUDDY_ALLOC);
+    ASSERT_NE(nullptr, big);
+    libc_free(big);
+    size_t brk = libc_heap_brk();
+    for (int i = 0; i < 32; i++) {
+        ptrs.push_back(libc_malloc(100));
+    }
+    for (size_t i = 0; i < ptrs.size(); i += 2) {
+        libc_free(ptrs[i]);
+    }
+    for (size_t i = 1; i < ptrs.size(); i += 2) {
+        libc_free(ptrs[i]);
+    }
+
+    // Everything merged back: the whole page can be allocated again without
+    // growing the heap.
+    big = libc_malloc(MAX_BUDDY_ALLOC);
+    EXPECT_NE(nullptr, big);
+    EXPECT_EQ(brk, libc_heap_brk());
+    libc_free(big);
+}
+
+TEST(MallocTest, UsableSize) {
+    EXPECT_EQ(0u, libc_malloc_usable_size(NULL));
+
+    void *small = libc_malloc(9);
+    void *medium = libc_malloc(100);
+    void *large = libc_malloc(2 * PAGE_SIZE);
+    EXPECT_EQ(12u, libc_malloc_usable_size(small));
+    EXPECT_EQ(128u - 2, libc_malloc_usable_size(medium));
+    EXPECT_EQ(3u * PAGE_SIZE - 4, libc_malloc_usable_size(large));
+    libc_free(small);
+    libc_free(medium);
+    libc_free(large);
+}
+
+TEST(MallocTest, ReallocNullAndZero) {
+    void *p = libc_realloc(NULL, 10);
+    ASSERT_NE(nullptr, p);
+    EXPECT_EQ(nullptr, libc_realloc(p, 0));
+}
+
+TEST(MallocTest, ReallocGrowsInPlace) {
+    // Start from a fresh page so that the upper buddies are free.
+    libc_free(libc_malloc(MAX_BUDDY_ALLOC));
+    struct allocation a = {nullptr, 100, 0x42};
+    a.ptr = (unsigned char *)libc_malloc(a.size);
+    ASSERT_NE(nullptr, a.ptr);
+    fill(&a);
+
+    unsigned char *p = (unsigned char *)libc_realloc(a.ptr, 1000);
+    EXPECT_EQ(a.ptr, p);
+    EXPECT_TRUE(check(&a));
+    EXPECT_GE(libc_malloc_usable_size(p), 1000u);
+
+    // Shrinking splits the block and releases the upper halves.
+    p = (unsigned char *)libc_realloc(p, 80);
+    EXPECT_EQ(a.ptr, p);
+    a.size = 80;
+    EXPECT_TRUE(check(&a));
+    EXPECT_EQ(128u - 2, libc_malloc_usable_size(p));
+    void *next = libc_malloc(100);
+    EXPECT_EQ(p + 128, next);
+    libc_free(next);
+    libc_free(p);
+}
+
+TEST(MallocTest, ReallocMoves) {
+    struct allocation a = {nullptr, 200, 0x24};
+    a.ptr = (unsigned char *)libc_malloc(a.size);
+    ASSERT_NE(nullptr, a.ptr);
+    fill(&a);
+
+    // Prevent in place growth by allocating the upper buddy.
+    void *blocker = libc_malloc(200);
+    ASSERT_EQ(a.ptr + 256, blocker);
+
+    unsigned char *p = (unsigned char *)libc_realloc(a.ptr, 400);
+    ASSERT_NE(nullptr, p);
+    EXPECT_NE(a.ptr, p);
+    a.ptr = p;
+    EXPECT_TRUE(check(&a));
+    libc_free(p);
+    libc_free(blocker);
+}
+
+TEST(MallocTest, ReallocAcrossAllocators) {
+    struct allocation a = {nullptr, 10, 0x11};
+    a.ptr = (unsigned char *)libc_malloc(a.size);
+    ASSERT_NE(nullptr, a.ptr);
+    fill(&a);
+
+    // Small to medium.
+    a.ptr = (unsigned char *)libc_realloc(a.ptr, 500);
+    ASSERT_NE(nullptr, a.ptr);
+    EXPECT_TRUE(check(&a));
+    a.size = 500;
+    fill(&a);
+
+    // Medium to large.
+    a.ptr = (unsigned char *)libc_realloc(a.ptr, 3 * PAGE_SIZE);
+    ASSERT_NE(nullptr, a.ptr);
+    EXPECT_TRUE(check(&a));
+    a.size = 3 * PAGE_SIZE;
+    fill(&a);
+
+    // Large allocations shrink in place.
+    unsigned char *p = (unsigned char *)libc_realloc(a.ptr, PAGE_SIZE + 1);
+    EXPECT_EQ(a.ptr, p);
+    a.size = PAGE_SIZE + 1;
+    EXPECT_TRUE(check(&a));
+    EXPECT_EQ(2u * PAGE_SIZE - 4, libc_malloc_usable_size(p));
+    libc_free(p);
+}
+
+TEST(MallocTest, Stats) {
+    struct malloc_stats before, st;
+    libc_malloc_get_stats(&before);
+
+    void *small = libc_malloc(9);
+    void *medium = libc_malloc(100);
+    libc_malloc_get_stats(&st);
+    EXPECT_EQ(before.allocs + 2, st.allocs);
+    EXPECT_EQ(before.in_use + 12 + 126, st.in_use);
+    EXPECT_GE(st.max_in_use, st.in_use);
+    EXPECT_EQ(libc_heap_brk(), st.heap_size);
+    EXPECT_GE(st.runs, 1u);
+
+    // In place resizes are accounted.
+    medium = libc_realloc(medium, 50);
+    libc_malloc_get_stats(&st);
+    EXPECT_EQ(before.in_use + 12 + 62, st.in_use);
+
+    libc_free(small);
+    libc_free(medium);
+    libc_malloc_get_stats(&st);
+    EXPECT_EQ(before.frees + 2, st.frees);
+    EXPECT_EQ(before.in_use, st.in_use);
+    EXPECT_GE(st.max_in_use, before.in_use + 12 + 126);
+
+    // Everything is free: the heap is made of free pages.
+    EXPECT_EQ(st.heap_size / PAGE_SIZE, st.free_blocks[MALLOC_ORDERS - 1]);
+    EXPECT_EQ((size_t)PAGE_SIZE, st.largest_free);
+    libc_malloc_print_stats();
+}
+
+// storm_size returns a random request size for the buddy allocator, with a few
+// multi-page requests.
+static size_t storm_size(std::mt19937 &rng) {
+    std::uniform_int_distribution<int> large_dist(0, 31);
+    std::uniform_int_distribution<size_t> medium(SMALL_MAX + 1,
+                                                 MAX_BUDDY_ALLOC);
+    std::uniform_int_distribution<size_t> large(PAGE_SIZE, 3 * PAGE_SIZE);
+
+    return large_dist(rng) ? medium(rng) : large(rng);
+}
+
+// storm_fill allocates the <live> blocks.
+static void storm_fill(std::vector<struct allocation> &live,
+                       std::mt19937 &rng) {
+    for (auto &a : live) {
+        a.size = storm_size(rng);
+        a.pattern = (unsigned char)a.size;
+        a.ptr = (unsigned char *)libc_malloc(a.size);
+        ASSERT_NE(nullptr, a.ptr);
+        fill(&a);
+    }
+}
+
+// storm frees and allocates again <rounds> random blocks of <live>. Returns the
+// average time of a free and malloc pair in nanoseconds.
+static double storm(std::vector<struct allocation> &live, int rounds,
+                    std::mt19937 &rng) {
+    std::uniform_int_distribution<size_t> slot_dist(0, live.size() - 1);
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < rounds; i++) {
+        struct allocation &a = live[slot_dist(rng)];
+        libc_free(a.ptr);
+        a.size = storm_size(rng);
+        a.pattern = (unsigned char)i;
+        a.ptr = (unsigned char *)libc_malloc(a.size);
+        if (!a.ptr) {
+            ADD_FAILURE() << "out of memory after " << i << " rounds";
+            return 0;
+        }
+        a.ptr[0] = a.pattern;
+        a.ptr[a.size - 1] = a.pattern;
+    }
+    std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count() / rounds;
+}
+
+// storm_release checks and frees the <live> blocks.
+static void storm_release(std::vector<struct allocation> &live) {
+    for (auto &a : live) {
+        if (!a.ptr) {
+            continue;
+        }
+        EXPECT_EQ(a.pattern, a.ptr[0]);
+        EXPECT_EQ(a.pattern, a.ptr[a.size - 1]);
+        libc_free(a.ptr);
+    }
+}
+
+// Allocation/free storm with random sizes served by the buddy allocator. It
+// keeps a large number of live blocks so that free lists get long, and checks
+// that the heap doesn't grow with the number of rounds and coalesces back once
+// everything is freed. Frees and allocations don't scan the free lists: the
+// cost of a round barely depends on the number of live blocks.
+TEST(MallocTest, AllocFreeStorm) {
+    const int kFew = 32;
+    const int kLive = 512;
+    const int kRounds = 100000;
+    std::mt19937 rng(0x8088);
+    std::vector<struct allocation> few(kFew);
+    std::vector<struct allocation> live(kLive);
+    struct malloc_stats before, filled, st;
+
+    // Reference cost, with short free lists.
+    ASSERT_NO_FATAL_FAILURE(storm_fill(few, rng));
+    double few_ns = storm(few, kRounds, rng);
+    storm_release(few);
+
+    libc_malloc_get_stats(&before);
+    ASSERT_NO_FATAL_FAILURE(storm_fill(live, rng));
+    libc_malloc_get_stats(&filled);
+    double live_ns = storm(live, kRounds, rng);
+
+    // Freed blocks are reused: with the same number of live blocks the heap
+    // stays bounded whatever the number of rounds. The multi-page blocks need
+    // contiguous free pages, which fragmentation makes scarce.
+    libc_malloc_get_stats(&st);
+    EXPECT_EQ(before.allocs + kLive + kRounds, st.allocs);
+    EXPECT_EQ(before.frees + kRounds, st.frees);
+    EXPECT_LE(st.heap_size, 2 * filled.heap_size);
+
+    // A scan of the free lists would make the rounds about kLive / kFew times
+    // slower.
+    printf("malloc storm: %.0f ns per free/malloc with %d live blocks, %.0f ns "
+           "with %d\n",
+           live_ns, kLive, few_ns, kFew);
+    EXPECT_LT(live_ns, 4 * few_ns);
+
+    storm_release(live);
+
+    // Everything is free again: the runs went back to free pages.
+    libc_malloc_get_stats(&st);
+    EXPECT_EQ(before.in_use, st.in_use);
+    EXPECT_EQ(before.frees + kRounds + kLive, st.frees);
+    EXPECT_EQ(before.runs, st.runs);
+}